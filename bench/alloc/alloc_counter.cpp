@@ -0,0 +1,36 @@
+#include "alloc_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Замена operator new живёт в отдельной единице трансляции: вызовы из
+// бенчмарков не встраиваются, и new/delete не смешиваются с malloc/free
+// на глазах у компилятора
+namespace {
+
+thread_local bool armed = false;
+thread_local AllocStats stats;
+
+} // namespace
+
+AllocScope::AllocScope() {
+  stats = {};
+  armed = true;
+}
+
+AllocScope::~AllocScope() { armed = false; }
+
+AllocStats last_alloc_stats() { return stats; }
+
+void *operator new(std::size_t size) {
+  if (armed) {
+    ++stats.count;
+    stats.bytes += size;
+  }
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
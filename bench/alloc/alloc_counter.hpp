@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+// Счётчик выделений памяти для бенчмарка пула. operator new заменён в
+// alloc_counter.cpp, который собирается только в dungeon_bench_alloc:
+// остальные бенчмарки работают со стандартным аллокатором. Считается
+// лишь внутри взведённого AllocScope и только в текущем потоке.
+struct AllocStats {
+  std::size_t count = 0;
+  std::size_t bytes = 0;
+};
+
+class AllocScope {
+public:
+  AllocScope();
+  ~AllocScope();
+
+  AllocScope(const AllocScope &) = delete;
+  AllocScope &operator=(const AllocScope &) = delete;
+};
+
+// Итог последнего AllocScope текущего потока
+AllocStats last_alloc_stats();
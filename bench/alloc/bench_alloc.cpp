@@ -0,0 +1,94 @@
+#include "../../include/dragon.hpp"
+#include "../../include/knight.hpp"
+#include "../../include/pegasus.hpp"
+#include "../../include/simulation.hpp"
+#include "../../include/world.hpp"
+#include "alloc_counter.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+constexpr int kWaves = 4;
+
+NpcType type_of(std::size_t i) { return NpcType(KnightType + i % 3); }
+
+// Имена длиннее буфера короткой строки std::string, но влезающие в таблицу мира
+std::vector<std::string> make_names(std::size_t count) {
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < count; ++i)
+    names.push_back(generate_name(type_of(i), int(i)) + "_the_bold");
+  return names;
+}
+
+void report(benchmark::State &state, std::size_t npcs) {
+  AllocStats stats = last_alloc_stats();
+  state.counters["allocs_per_npc"] = double(stats.count) / double(npcs);
+  state.counters["bytes_per_npc"] = double(stats.bytes) / double(npcs);
+  state.SetItemsProcessed(state.iterations() * npcs);
+}
+
+// Прежний путь: make_shared на каждого NPC и std::string на каждое имя,
+// погибшие остаются в массивах, новые всегда дописываются в конец
+void BM_SpawnMakeShared(benchmark::State &state) {
+  std::size_t count = state.range(0);
+  auto source = make_names(count);
+  for (auto _ : state) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    std::vector<std::string> names;
+    AllocScope scope;
+    for (int wave = 0; wave < kWaves; ++wave) {
+      for (std::size_t i = 0; i < count; ++i) {
+        NpcType type = type_of(i);
+        names.push_back(source[i]);
+        entity_id id = world.spawn(type, 0, 0, names.back());
+        switch (type) {
+        case KnightType:
+          npcs.push_back(std::make_shared<Knight>(world, id));
+          break;
+        case DragonType:
+          npcs.push_back(std::make_shared<Dragon>(world, id));
+          break;
+        default:
+          npcs.push_back(std::make_shared<Pegasus>(world, id));
+          break;
+        }
+      }
+      for (std::size_t id = npcs.size() - count; id < npcs.size(); ++id)
+        world.alive[id] = 0;
+    }
+    benchmark::DoNotOptimize(npcs.data());
+  }
+  report(state, count * kWaves);
+}
+
+// Пул мира: ручки из пласта, имена во встроенной таблице, слоты погибших
+// переиспользуются следующей волной
+void BM_SpawnPooled(benchmark::State &state) {
+  std::size_t count = state.range(0);
+  auto source = make_names(count);
+  for (auto _ : state) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    AllocScope scope;
+    for (int wave = 0; wave < kWaves; ++wave) {
+      for (std::size_t i = 0; i < count; ++i) {
+        NpcType type = type_of(i);
+        entity_id id = world.spawn(type, 0, 0, source[i]);
+        if (id < npcs.size())
+          npcs[id] = make_handle(world, id);
+        else
+          npcs.push_back(make_handle(world, id));
+      }
+      for (entity_id id = 0; id < npcs.size(); ++id)
+        world.kill(id);
+    }
+    benchmark::DoNotOptimize(npcs.data());
+  }
+  report(state, count * kWaves);
+}
+
+} // namespace
+
+BENCHMARK(BM_SpawnMakeShared)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_SpawnPooled)->Arg(1000)->Arg(100000);
@@ -0,0 +1,64 @@
+#include "../include/behavior.hpp"
+#include "../include/simulation.hpp"
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+namespace {
+
+Behavior drifter(Agent self, std::uint64_t period) {
+  for (;;) {
+    self.wander();
+    co_await self.sleep(period);
+  }
+}
+
+// 1M спящих поведений: просыпается каждое period-е на тике.
+// Память - кадры сопрограмм плюс состояние планировщика на NPC.
+void BM_BehaviorResumes(benchmark::State &state) {
+  const std::size_t n = 1000000;
+  const int side = 100000;
+  const std::uint64_t period = state.range(0);
+  World world;
+  world.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    world.spawn(NpcType(i % 3 + 1), int(i % side), int(i / side), "N");
+
+  std::size_t frames_before = behavior_frame_bytes();
+  BehaviorScheduler scheduler(world, side, side, 1);
+  for (entity_id id = 0; id < n; ++id)
+    scheduler.attach(id, drifter(Agent(scheduler, id), period));
+  std::uint64_t tick = 0;
+  scheduler.run(tick++); // первый запуск всех
+
+  std::size_t resumes = 0;
+  for (auto _ : state)
+    resumes += scheduler.run(tick++);
+  state.counters["resumes/s"] = benchmark::Counter(double(resumes), benchmark::Counter::kIsRate);
+  state.counters["frame_bytes"] = double(behavior_frame_bytes() - frames_before) / n;
+}
+
+// Полный тик с поведениями по умолчанию: охота, бегство, патруль
+void BM_BehaviorTick(benchmark::State &state) {
+  SimulationConfig config;
+  config.seed = 42;
+  config.npc_count = state.range(0);
+  config.max_x = config.max_y = std::max(100, int(std::sqrt(config.npc_count * 200.0)));
+  config.behaviors = true;
+
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+  ThreadPool pool;
+  Simulation simulation(world, npcs, config, &pool);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(simulation.step());
+  state.counters["ticks/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  state.counters["watching"] = double(simulation.get_behaviors()->watching());
+}
+
+} // namespace
+
+BENCHMARK(BM_BehaviorResumes)->ArgName("period")->Arg(1)->Arg(16)->Arg(1000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BehaviorTick)->ArgName("npcs")->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,86 @@
+#include "../include/journal.hpp"
+#include "../include/simulation.hpp"
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <filesystem>
+
+namespace {
+
+const std::size_t kNpcs = 1000000;
+const int kSide = 14142;
+const char *const kDir = "bench_checkpoints";
+
+World &checkpoint_world() {
+  static World world;
+  static std::vector<std::shared_ptr<NPC>> npcs;
+  if (world.size() == 0)
+    populate(world, npcs, kNpcs, kSide, kSide, 42);
+  return world;
+}
+
+// Прежний путь: полный снимок на потоке тика
+void BM_CheckpointFullSave(benchmark::State &state) {
+  World &world = checkpoint_world();
+  for (auto _ : state)
+    save_snapshot(world, "bench_checkpoint.bin");
+  std::remove("bench_checkpoint.bin");
+}
+
+// Пауза commit, когда за тик сдвинулась доля NPC moved_pct процентов
+void BM_CheckpointCommit(benchmark::State &state) {
+  World &world = checkpoint_world();
+  const std::size_t stride = 100 / std::size_t(state.range(0));
+  std::uint64_t tick = 0;
+  std::size_t bytes = 0;
+  {
+    Checkpointer checkpoints(world, kDir, ~std::uint64_t(0) / 2);
+    for (auto _ : state) {
+      state.PauseTiming();
+      int step = ++tick % 2 ? 1 : -1;
+      for (entity_id id = 0; id < world.size(); id += entity_id(stride))
+        world.move(id, step, step, kSide, kSide);
+      state.ResumeTiming();
+      checkpoints.commit(tick);
+    }
+    bytes = checkpoints.stats().journal_bytes;
+  }
+  std::filesystem::remove_all(kDir);
+  state.counters["bytes/tick"] = double(bytes) / double(tick);
+}
+
+// Копия мира для фонового снимка - вся его пауза на потоке тика
+void BM_CheckpointCapture(benchmark::State &state) {
+  World &world = checkpoint_world();
+  SnapshotImage image;
+  for (auto _ : state)
+    capture_snapshot(world, image);
+}
+
+// Тик симуляции без контрольных точек и с ними (снимок раз в 10 тиков)
+void BM_CheckpointTick(benchmark::State &state) {
+  SimulationConfig config;
+  config.seed = 42;
+  config.npc_count = 100000;
+  config.max_x = config.max_y = int(std::sqrt(config.npc_count * 200.0));
+  if (state.range(0)) {
+    config.checkpoint_dir = kDir;
+    config.checkpoint_every = 10;
+  }
+  {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+    Simulation simulation(world, npcs, config);
+    for (auto _ : state)
+      benchmark::DoNotOptimize(simulation.step());
+  }
+  std::filesystem::remove_all(kDir);
+}
+
+} // namespace
+
+BENCHMARK(BM_CheckpointFullSave)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CheckpointCommit)->ArgName("moved_pct")->Arg(1)->Arg(10)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CheckpointCapture)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CheckpointTick)->ArgName("checkpoints")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
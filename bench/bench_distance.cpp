@@ -0,0 +1,57 @@
+#include "../include/distance.hpp"
+#include "../include/knight.hpp"
+#include "../include/world.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+constexpr int kBlock = 4096;
+
+void BM_IsCloseScalar(benchmark::State &state) {
+  World world;
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<> coord(0, 1000);
+  std::vector<std::shared_ptr<NPC>> npcs;
+  for (int i = 0; i < kBlock; ++i)
+    npcs.push_back(std::make_shared<Knight>(world, world.spawn(KnightType, coord(gen), coord(gen), "K")));
+  auto attacker = npcs[0];
+
+  for (auto _ : state) {
+    std::size_t hits = 0;
+    for (auto &npc : npcs)
+      hits += attacker->is_close(npc, 30);
+    benchmark::DoNotOptimize(hits);
+  }
+  state.SetItemsProcessed(state.iterations() * kBlock);
+}
+
+void BM_WithinDistance(benchmark::State &state) {
+  SimdLevel previous = get_simd_level();
+  set_simd_level(SimdLevel(state.range(0)));
+  if (get_simd_level() != SimdLevel(state.range(0))) {
+    set_simd_level(previous);
+    state.SkipWithError("SIMD level not supported");
+    return;
+  }
+
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<> coord(0, 1000);
+  std::vector<int> xs(kBlock), ys(kBlock);
+  for (int i = 0; i < kBlock; ++i) {
+    xs[i] = coord(gen);
+    ys[i] = coord(gen);
+  }
+  std::vector<std::uint32_t> out(kBlock);
+
+  for (auto _ : state) {
+    std::size_t hits = within_distance(xs[0], ys[0], xs.data(), ys.data(), kBlock, 30, out.data());
+    benchmark::DoNotOptimize(hits);
+  }
+  state.SetItemsProcessed(state.iterations() * kBlock);
+  set_simd_level(previous);
+}
+
+} // namespace
+
+BENCHMARK(BM_IsCloseScalar);
+BENCHMARK(BM_WithinDistance)->ArgName("simd")->Arg(0)->Arg(1)->Arg(2);
@@ -0,0 +1,117 @@
+#include "../include/frame.hpp"
+#include "../include/render.hpp"
+#include "../include/simulation.hpp"
+#include <benchmark/benchmark.h>
+
+#include <shared_mutex>
+
+namespace {
+
+// Прежняя печать карты: блокировка мира на каждый аксессор ручки
+void BM_ReadLockedAccessors(benchmark::State &state) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, state.range(0), 1000, 1000, 1);
+  for (auto _ : state) {
+    long sum = 0;
+    for (auto &npc : npcs) {
+      bool alive;
+      {
+        std::shared_lock lock(world.get_mutex());
+        alive = world.alive[npc->get_id()];
+      }
+      if (!alive) continue;
+      {
+        std::shared_lock lock(world.get_mutex());
+        sum += world.name(npc->get_id()).size();
+      }
+      {
+        std::shared_lock lock(world.get_mutex());
+        sum += world.x[npc->get_id()];
+      }
+      {
+        std::shared_lock lock(world.get_mutex());
+        sum += world.y[npc->get_id()];
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Аксессоры ручек без блокировок - доступ владельца мира внутри фазы
+void BM_ReadAccessors(benchmark::State &state) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, state.range(0), 1000, 1000, 1);
+  for (auto _ : state) {
+    long sum = 0;
+    for (auto &npc : npcs) {
+      if (!npc->is_alive()) continue;
+      sum += world.name(npc->get_id()).size() + npc->get_x() + npc->get_y();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Читатель вне тика: один захват кадра и одна блокировка имён на проход
+void BM_ReadFrame(benchmark::State &state) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, state.range(0), 1000, 1000, 1);
+  FrameBuffer frames;
+  frames.publish(world, 0);
+  for (auto _ : state) {
+    auto frame = frames.acquire();
+    std::shared_lock names_lock(world.get_mutex());
+    long sum = 0;
+    for (entity_id i = 0; i < frame->size(); ++i) {
+      if (!frame->alive[i]) continue;
+      sum += world.name(i).size() + frame->x[i] + frame->y[i];
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Цена публикации кадра в конце тика
+void BM_FramePublish(benchmark::State &state) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, state.range(0), 1000, 1000, 1);
+  FrameBuffer frames;
+  std::uint64_t tick = 0;
+  for (auto _ : state)
+    frames.publish(world, ++tick);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Отрисовка кадра в буфер: список, сетка плотности и разница кадров
+void BM_RenderFrame(benchmark::State &state) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, state.range(0), 1000, 1000, 1);
+  FrameBuffer frames;
+  frames.publish(world, 0);
+  MapRenderer renderer(RenderMode(state.range(1)), 1000, 1000);
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    renderer.render(*frames.acquire(), world, out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["bytes"] = double(out.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_ReadLockedAccessors)->ArgName("npcs")->Arg(1000)->Arg(100000);
+BENCHMARK(BM_ReadAccessors)->ArgName("npcs")->Arg(1000)->Arg(100000);
+BENCHMARK(BM_ReadFrame)->ArgName("npcs")->Arg(1000)->Arg(100000);
+BENCHMARK(BM_FramePublish)->ArgName("npcs")->Arg(1000)->Arg(100000);
+BENCHMARK(BM_RenderFrame)
+    ->ArgNames({"npcs", "mode"})
+    ->ArgsProduct({{1000, 100000},
+                   {int(RenderMode::List), int(RenderMode::Density), int(RenderMode::Diff)}});
@@ -0,0 +1,127 @@
+#include "../include/dragon.hpp"
+#include "../include/grid.hpp"
+#include "../include/knight.hpp"
+#include "../include/pegasus.hpp"
+#include "../include/world.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// Плотность как в main: около 50 NPC на карту 100x100
+int map_side(std::size_t n) {
+  return std::max(100, static_cast<int>(std::sqrt(n * 200.0)));
+}
+
+std::vector<std::shared_ptr<NPC>> make_npcs(std::size_t n, int side) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> coord(0, side);
+  std::vector<std::shared_ptr<NPC>> npcs;
+  npcs.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    int x = coord(gen), y = coord(gen);
+    switch (i % 3) {
+    case 0:
+      npcs.push_back(std::make_shared<Knight>(x, y, "K"));
+      break;
+    case 1:
+      npcs.push_back(std::make_shared<Dragon>(x, y, "D"));
+      break;
+    default:
+      npcs.push_back(std::make_shared<Pegasus>(x, y, "P"));
+    }
+  }
+  return npcs;
+}
+
+void BM_TickBruteForce(benchmark::State &state) {
+  std::size_t n = state.range(0);
+  int side = map_side(n);
+  auto npcs = make_npcs(n, side);
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<> dir_dist(-1, 1);
+
+  for (auto _ : state) {
+    std::size_t pairs = 0;
+    for (std::size_t i = 0; i < npcs.size(); ++i) {
+      auto &npc1 = npcs[i];
+      int move_dist = npc1->get_move_distance();
+      npc1->move(dir_dist(gen) * move_dist, dir_dist(gen) * move_dist, side, side);
+      for (std::size_t j = 0; j < npcs.size(); ++j) {
+        if (i != j && npc1->is_close(npcs[j], npc1->get_kill_distance()))
+          ++pairs;
+      }
+    }
+    benchmark::DoNotOptimize(pairs);
+  }
+  state.counters["ticks/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void BM_TickGrid(benchmark::State &state) {
+  std::size_t n = state.range(0);
+  int side = map_side(n);
+  auto npcs = make_npcs(n, side);
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<> dir_dist(-1, 1);
+
+  SpatialGrid grid(30, side, side);
+  for (std::size_t i = 0; i < npcs.size(); ++i)
+    grid.insert(i, npcs[i]->get_x(), npcs[i]->get_y());
+
+  for (auto _ : state) {
+    std::size_t pairs = 0;
+    for (std::size_t i = 0; i < npcs.size(); ++i) {
+      auto &npc1 = npcs[i];
+      int move_dist = npc1->get_move_distance();
+      int old_x = npc1->get_x(), old_y = npc1->get_y();
+      npc1->move(dir_dist(gen) * move_dist, dir_dist(gen) * move_dist, side, side);
+      int x = npc1->get_x(), y = npc1->get_y();
+      grid.update(i, old_x, old_y, x, y);
+      grid.for_each_near(x, y, [&](std::size_t j) {
+        if (i != j && npc1->is_close(npcs[j], npc1->get_kill_distance()))
+          ++pairs;
+      });
+    }
+    benchmark::DoNotOptimize(pairs);
+  }
+  state.counters["ticks/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// Тот же тик по массивам World без обращения к объектам NPC
+void BM_TickWorldGrid(benchmark::State &state) {
+  std::size_t n = state.range(0);
+  int side = map_side(n);
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> coord(0, side);
+  World world;
+  world.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    world.spawn(NpcType(i % 3 + 1), coord(gen), coord(gen), "N");
+
+  std::uniform_int_distribution<> dir_dist(-1, 1);
+  SpatialGrid grid(30, side, side);
+  for (entity_id i = 0; i < world.size(); ++i)
+    grid.insert(i, world.x[i], world.y[i]);
+
+  for (auto _ : state) {
+    std::size_t pairs = 0;
+    for (entity_id i = 0; i < world.size(); ++i) {
+      int move_dist = world.move_distance[i];
+      int old_x = world.x[i], old_y = world.y[i];
+      world.move(i, dir_dist(gen) * move_dist, dir_dist(gen) * move_dist, side, side);
+      grid.update(i, old_x, old_y, world.x[i], world.y[i]);
+      grid.for_each_near(world.x[i], world.y[i], [&](std::size_t j) {
+        if (i != j && world.is_close(i, j, world.kill_distance[i]))
+          ++pairs;
+      });
+    }
+    benchmark::DoNotOptimize(pairs);
+  }
+  state.counters["ticks/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+// Перебор на 100k - 10^10 пар за тик, его не гоняем
+BENCHMARK(BM_TickBruteForce)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TickGrid)->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TickWorldGrid)->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
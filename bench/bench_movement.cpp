@@ -0,0 +1,75 @@
+#include "../include/movement.hpp"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// Масштабирование тика движения по числу потоков, 100k NPC
+void BM_MovementTick(benchmark::State &state) {
+  const std::size_t n = 100000;
+  const int side = 4500;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> coord(0, side);
+  World world;
+  world.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    world.spawn(NpcType(i % 3 + 1), coord(gen), coord(gen), "N");
+
+  ThreadPool pool(state.range(0));
+  MovementSystem movement(world, side, side, 1, &pool);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(movement.tick().size());
+  state.counters["ticks/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// Карта 1 000 000 x 1 000 000, 1M NPC: тайлы по умолчанию против одного тайла
+void BM_HugeMapTick(benchmark::State &state) {
+  const std::size_t n = 1000000;
+  const int side = 1000000;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> coord(0, side);
+  World world;
+  world.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    world.spawn(NpcType(i % 3 + 1), coord(gen), coord(gen), "N");
+
+  ThreadPool pool;
+  MovementSystem movement(world, side, side, 1, &pool, int(state.range(0)));
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(movement.tick().size());
+  state.counters["tiles"] = double(movement.get_tiles().tile_count());
+  state.counters["guests"] = double(movement.get_tiles().guest_count());
+}
+
+// Война на истощение: 200k созданных NPC, из них живо live процентов.
+// Тик должен дешеветь вместе с населением, а не стоять на числе слотов.
+void BM_AttritionTick(benchmark::State &state) {
+  const std::size_t n = 200000;
+  const int side = 6400;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> coord(0, side);
+  World world;
+  world.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    world.spawn(NpcType(i % 3 + 1), coord(gen), coord(gen), "N");
+  const std::size_t keep_every = 100 / state.range(0);
+  for (entity_id i = 0; i < n; ++i) {
+    if (i % keep_every != 0)
+      world.kill(i);
+  }
+
+  MovementSystem movement(world, side, side, 1);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(movement.tick().size());
+  state.counters["alive"] = double(world.alive_count());
+}
+
+} // namespace
+
+BENCHMARK(BM_MovementTick)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_HugeMapTick)->ArgName("tile")->Arg(0)->Arg(1000000)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_AttritionTick)->ArgName("live")->Arg(100)->Arg(20)->Arg(5)->Arg(1)
+    ->Unit(benchmark::kMillisecond);
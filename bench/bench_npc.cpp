@@ -0,0 +1,119 @@
+#include "../include/dragon.hpp"
+#include "../include/knight.hpp"
+#include "../include/pegasus.hpp"
+#include "../include/fight.hpp"
+#include "../include/simulation.hpp"
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+
+namespace {
+
+class CountingObserver : public IFightObserver {
+public:
+  std::size_t fights = 0;
+
+  void on_fight(const std::shared_ptr<NPC>, const std::shared_ptr<NPC>, bool) override {
+    ++fights;
+  }
+};
+
+void BM_IsClose(benchmark::State &state) {
+  auto a = std::make_shared<Knight>(0, 0, "A");
+  auto b = std::make_shared<Dragon>(3, 4, "B");
+  for (auto _ : state)
+    benchmark::DoNotOptimize(a->is_close(b, 5));
+}
+
+void BM_AcceptVisit(benchmark::State &state) {
+  auto knight = std::make_shared<Knight>(0, 0, "K");
+  auto dragon = std::make_shared<Dragon>(0, 0, "D");
+  auto pegasus = std::make_shared<Pegasus>(0, 0, "P");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dragon->accept(knight));
+    benchmark::DoNotOptimize(pegasus->accept(dragon));
+    benchmark::DoNotOptimize(knight->accept(pegasus));
+  }
+  state.SetItemsProcessed(state.iterations() * 3);
+}
+
+void BM_FightTable(benchmark::State &state) {
+  auto knight = std::make_shared<Knight>(0, 0, "K");
+  auto dragon = std::make_shared<Dragon>(0, 0, "D");
+  auto pegasus = std::make_shared<Pegasus>(0, 0, "P");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(resolve_fight(knight, dragon));
+    benchmark::DoNotOptimize(resolve_fight(dragon, pegasus));
+    benchmark::DoNotOptimize(resolve_fight(pegasus, knight));
+  }
+  state.SetItemsProcessed(state.iterations() * 3);
+}
+
+void BM_Save(benchmark::State &state) {
+  Knight knight(100, 200, "Knight_12345");
+  std::ostringstream os;
+  for (auto _ : state) {
+    os.str("");
+    knight.save(os);
+  }
+}
+
+void BM_LoadFromStream(benchmark::State &state) {
+  std::ostringstream os;
+  Knight(100, 200, "Knight_12345").save(os);
+  std::string text = os.str();
+  for (auto _ : state) {
+    std::istringstream is(text);
+    int type;
+    is >> type;
+    Knight knight(is);
+    benchmark::DoNotOptimize(knight.get_id());
+  }
+}
+
+void BM_FightNotify(benchmark::State &state) {
+  auto knight = std::make_shared<Knight>(0, 0, "K");
+  auto dragon = std::make_shared<Dragon>(0, 0, "D");
+  auto observer = std::make_shared<CountingObserver>();
+  for (int i = 0; i < state.range(0); ++i)
+    knight->subscribe(observer);
+
+  for (auto _ : state)
+    knight->fight_notify(dragon, true);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+class CountingBusObserver : public IEventObserver {
+public:
+  std::size_t fights = 0;
+
+  void on_events(const std::vector<FightOutcome> &events) override { fights += events.size(); }
+};
+
+// Тик из 256 боёв через шину мира: цена не зависит от числа NPC в мире
+void BM_EventBusTick(benchmark::State &state) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, state.range(0), 1000, 1000, 1);
+  auto all = std::make_shared<CountingBusObserver>();
+  auto kills = std::make_shared<CountingBusObserver>();
+  world.events.subscribe(all);
+  world.events.subscribe(kills, EventFilter::only(FightKind::Kill));
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < 256; ++i)
+      resolve_fight(npcs[i % npcs.size()], npcs[(i * 7 + 1) % npcs.size()]);
+    world.events.dispatch();
+  }
+  state.SetItemsProcessed(state.iterations() * 256);
+}
+
+} // namespace
+
+BENCHMARK(BM_IsClose);
+BENCHMARK(BM_AcceptVisit);
+BENCHMARK(BM_FightTable);
+BENCHMARK(BM_Save);
+BENCHMARK(BM_LoadFromStream);
+BENCHMARK(BM_FightNotify)->ArgName("observers")->Arg(2)->Arg(8);
+BENCHMARK(BM_EventBusTick)->ArgName("npcs")->Arg(1000)->Arg(1000000);
@@ -0,0 +1,62 @@
+#include "../include/combat.hpp"
+#include "../include/simulation.hpp"
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+namespace {
+
+// Полный тик: движение, поиск пар и бои; плотность как в main
+void BM_SimulationTick(benchmark::State &state) {
+  SimulationConfig config;
+  config.seed = 42;
+  config.npc_count = state.range(0);
+  config.max_x = config.max_y = std::max(100, int(std::sqrt(config.npc_count * 200.0)));
+
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+  ThreadPool pool;
+  Simulation simulation(world, npcs, config, &pool);
+  Metrics metrics;
+  if (state.range(1))
+    simulation.set_metrics(&metrics);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(simulation.step());
+  state.counters["ticks/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  state.counters["alive"] = world.alive_count();
+}
+
+// Бои одного тика пачкой: слияние пар, раунды и кубики в threads потоков.
+// Плотная карта, чтобы раунды были длиннее CombatBatch::kParallelRound.
+void BM_CombatBatch(benchmark::State &state) {
+  const std::size_t count = 100000;
+  const int side = 3000;
+  ThreadPool pool(state.range(0));
+  CombatBatch combat;
+  std::size_t candidates = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, count, side, side, 7);
+    MovementSystem movement(world, side, side, 7);
+    const auto &tick = movement.tick();
+    candidates = tick.size();
+    state.ResumeTiming();
+
+    combat.build(tick);
+    benchmark::DoNotOptimize(combat.resolve(world, npcs, 7, 0, &pool));
+  }
+  state.counters["candidates"] = candidates;
+  state.counters["pairs"] = combat.get_pairs().size();
+  state.counters["rounds"] = combat.round_count();
+}
+
+} // namespace
+
+// metrics:1 - с включёнными метриками, для оценки их цены
+BENCHMARK(BM_SimulationTick)->ArgNames({"npcs", "metrics"})
+    ->ArgsProduct({{100, 10000, 1000000}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CombatBatch)->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,84 @@
+#include "../include/simulation.hpp"
+#include "../include/snapshot.hpp"
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+const std::size_t kNpcs = 1000000;
+
+World &big_world() {
+  static World world;
+  static std::vector<std::shared_ptr<NPC>> npcs;
+  if (world.size() == 0)
+    populate(world, npcs, kNpcs, 10000, 10000, 42);
+  return world;
+}
+
+// Прежний путь: NPC::save построчно (теперь без сброса на каждом поле)
+void BM_TextSave(benchmark::State &state) {
+  World &world = big_world();
+  for (auto _ : state) {
+    std::ofstream os("bench_world.txt");
+    export_text(world, os);
+  }
+  std::remove("bench_world.txt");
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+void BM_TextLoad(benchmark::State &state) {
+  {
+    std::ofstream os("bench_world.txt");
+    export_text(big_world(), os);
+  }
+  for (auto _ : state) {
+    World world;
+    std::ifstream is("bench_world.txt");
+    benchmark::DoNotOptimize(import_text(world, is));
+  }
+  std::remove("bench_world.txt");
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+void BM_SnapshotSave(benchmark::State &state) {
+  World &world = big_world();
+  for (auto _ : state)
+    save_snapshot(world, "bench_world.bin");
+  std::remove("bench_world.bin");
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+void BM_SnapshotLoad(benchmark::State &state) {
+  save_snapshot(big_world(), "bench_world.bin");
+  for (auto _ : state) {
+    World world;
+    SnapshotView("bench_world.bin").load_into(world);
+    benchmark::DoNotOptimize(world.size());
+  }
+  std::remove("bench_world.bin");
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+// Только отображение и проход по позициям без копирования в World
+void BM_SnapshotMapScan(benchmark::State &state) {
+  save_snapshot(big_world(), "bench_world.bin");
+  for (auto _ : state) {
+    SnapshotView view("bench_world.bin");
+    std::int64_t sum = 0;
+    for (std::size_t i = 0; i < view.size(); ++i)
+      sum += view[i].x + view[i].y;
+    benchmark::DoNotOptimize(sum);
+  }
+  std::remove("bench_world.bin");
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+} // namespace
+
+BENCHMARK(BM_TextSave)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TextLoad)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SnapshotSave)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SnapshotLoad)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SnapshotMapScan)->Unit(benchmark::kMillisecond);
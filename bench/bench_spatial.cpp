@@ -0,0 +1,133 @@
+#include "../include/simulation.hpp"
+#include "../include/spatial_index.hpp"
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+namespace {
+
+// 1M NPC с плотностью как в main
+struct SpatialWorld {
+  static constexpr std::size_t kCount = 1000000;
+
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  int side = int(std::sqrt(kCount * 200.0));
+  SpatialIndex index;
+
+  SpatialWorld() {
+    populate(world, npcs, kCount, side, side, 42);
+    index.build(world);
+  }
+
+  // Центры запросов, одинаковые между прогонами
+  std::pair<int, int> point(std::size_t q) const {
+    return {int(q * 7919 % std::size_t(side)), int(q * 104729 % std::size_t(side))};
+  }
+};
+
+SpatialWorld &spatial_world() {
+  static SpatialWorld world;
+  return world;
+}
+
+void BM_SpatialBuild(benchmark::State &state) {
+  auto &sw = spatial_world();
+  SpatialIndex index;
+  for (auto _ : state)
+    index.build(sw.world);
+  state.counters["npcs"] = double(index.size());
+}
+
+void BM_SpatialRefit(benchmark::State &state) {
+  auto &sw = spatial_world();
+  SpatialIndex index;
+  index.build(sw.world);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(index.refit(sw.world));
+}
+
+// Радиус range, все типы или только драконы
+void BM_RadiusQuery(benchmark::State &state) {
+  auto &sw = spatial_world();
+  RadiusQuery query{0, 0, int(state.range(0)), state.range(1) ? type_bit(DragonType) : kAnyType};
+  std::vector<entity_id> out;
+  std::size_t q = 0, found = 0;
+  for (auto _ : state) {
+    std::tie(query.x, query.y) = sw.point(q++);
+    out.clear();
+    sw.index.within_radius(query, out);
+    found += out.size();
+  }
+  state.counters["found"] = double(found) / double(state.iterations());
+}
+
+// Для сравнения: перебор всех NPC тем же запросом
+void BM_RadiusBruteForce(benchmark::State &state) {
+  auto &sw = spatial_world();
+  const World &world = sw.world;
+  const std::int64_t limit = 50 * 50;
+  std::size_t q = 0;
+  for (auto _ : state) {
+    auto [x, y] = sw.point(q++);
+    std::size_t found = 0;
+    for (entity_id id = 0; id < world.size(); ++id) {
+      std::int64_t dx = world.x[id] - x, dy = world.y[id] - y;
+      found += world.alive[id] && dx * dx + dy * dy <= limit;
+    }
+    benchmark::DoNotOptimize(found);
+  }
+}
+
+void BM_NearestQuery(benchmark::State &state) {
+  auto &sw = spatial_world();
+  NearestQuery query{0, 0, std::size_t(state.range(0))};
+  std::vector<entity_id> out;
+  std::size_t q = 0;
+  for (auto _ : state) {
+    std::tie(query.x, query.y) = sw.point(q++);
+    out.clear();
+    sw.index.nearest(query, out);
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+
+void BM_BoxQuery(benchmark::State &state) {
+  auto &sw = spatial_world();
+  const int half = int(state.range(0)) / 2;
+  std::vector<entity_id> out;
+  std::size_t q = 0, found = 0;
+  for (auto _ : state) {
+    auto [x, y] = sw.point(q++);
+    out.clear();
+    sw.index.in_box({x - half, y - half, x + half, y + half}, out);
+    found += out.size();
+  }
+  state.counters["found"] = double(found) / double(state.iterations());
+}
+
+// 10 000 запросов радиуса 50 одной пачкой
+void BM_RadiusBatch(benchmark::State &state) {
+  auto &sw = spatial_world();
+  std::vector<RadiusQuery> queries;
+  for (std::size_t q = 0; q < 10000; ++q) {
+    auto [x, y] = sw.point(q);
+    queries.push_back({x, y, 50});
+  }
+  ThreadPool pool(state.range(0));
+  QueryResults results;
+  for (auto _ : state)
+    sw.index.query(queries, results, &pool);
+  state.counters["queries/s"] =
+      benchmark::Counter(double(queries.size() * state.iterations()), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+BENCHMARK(BM_SpatialBuild)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SpatialRefit)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RadiusQuery)->ArgNames({"radius", "dragons"})->ArgsProduct({{10, 50, 200}, {0, 1}});
+BENCHMARK(BM_RadiusBruteForce)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_NearestQuery)->ArgName("k")->Arg(1)->Arg(8)->Arg(64);
+BENCHMARK(BM_BoxQuery)->ArgName("side")->Arg(100)->Arg(1000);
+BENCHMARK(BM_RadiusBatch)->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,92 @@
+#include "../include/simulation.hpp"
+#include "../include/snapshot.hpp"
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <sstream>
+
+namespace {
+
+const std::size_t kNpcs = 1000000;
+const int kSide = 14142;
+
+// Прежняя расстановка: по одному NPC через create_npc, имя склейкой строк
+void BM_SpawnOneByOne(benchmark::State &state) {
+  for (auto _ : state) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> type_dist(KnightType, PegasusType);
+    std::uniform_int_distribution<> coord(0, kSide);
+    world.reserve(kNpcs);
+    npcs.reserve(kNpcs);
+    for (std::size_t i = 0; i < kNpcs; ++i) {
+      NpcType type = NpcType(type_dist(gen));
+      int x = coord(gen);
+      int y = coord(gen);
+      npcs.push_back(create_npc(world, type, x, y, generate_name(type, int(i))));
+    }
+    benchmark::DoNotOptimize(npcs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+// spawn_population на пуле из threads потоков, вместе с ручками
+void BM_SpawnBulk(benchmark::State &state) {
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, kNpcs, kSide, kSide, 42, &pool);
+    benchmark::DoNotOptimize(npcs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNpcs);
+}
+
+const std::string &exported_text() {
+  static std::string text = [] {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, kNpcs, kSide, kSide, 42);
+    std::ostringstream os;
+    export_text(world, os);
+    return os.str();
+  }();
+  return text;
+}
+
+// Прежний импорт: operator>> и getline поле за полем, spawn на каждого
+void BM_ImportStream(benchmark::State &state) {
+  const std::string &text = exported_text();
+  for (auto _ : state) {
+    World world;
+    std::istringstream is(text);
+    int type, x, y;
+    std::string name;
+    while (is >> type >> x >> y) {
+      is.ignore();
+      std::getline(is, name);
+      world.spawn(NpcType(type), x, y, name);
+    }
+    benchmark::DoNotOptimize(world.size());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+// import_text из буфера: from_chars по частям на пуле и spawn_bulk
+void BM_ImportParallel(benchmark::State &state) {
+  const std::string &text = exported_text();
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    World world;
+    benchmark::DoNotOptimize(import_text(world, text, &pool));
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_SpawnOneByOne)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SpawnBulk)->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ImportStream)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ImportParallel)->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
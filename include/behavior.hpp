@@ -0,0 +1,205 @@
+#pragma once
+
+#include "grid.hpp"
+#include "metrics.hpp"
+#include "thread_pool.hpp"
+#include "world.hpp"
+
+#include <coroutine>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class BehaviorScheduler;
+
+constexpr entity_id kNoEntity = std::numeric_limits<entity_id>::max();
+constexpr std::uint64_t kForever = std::numeric_limits<std::uint64_t>::max();
+
+// Кого ищет датчик: добычу (её NPC может убить) или угрозу (она может убить NPC)
+enum Sense : std::uint8_t { SensePrey = 1, SenseThreat = 2 };
+
+// Поведение NPC - сопрограмма. Она ждёт тиков или условий через co_await
+// на Agent и возобновляется планировщиком только тогда, когда ожидание
+// сработало. Кадр сопрограммы берётся из пулов по классам размера.
+class Behavior {
+public:
+  struct promise_type {
+    Behavior get_return_object() { return Behavior(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { throw; }
+
+    static void *operator new(std::size_t size);
+    static void operator delete(void *frame, std::size_t size);
+  };
+
+  Behavior(Behavior &&other) noexcept : handle(other.handle) { other.handle = {}; }
+  Behavior(const Behavior &) = delete;
+  Behavior &operator=(const Behavior &) = delete;
+  ~Behavior() {
+    if (handle)
+      handle.destroy();
+  }
+
+  // Владение кадром переходит к планировщику
+  std::coroutine_handle<> release() {
+    auto result = handle;
+    handle = {};
+    return result;
+  }
+
+private:
+  explicit Behavior(std::coroutine_handle<promise_type> _handle) : handle(_handle) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// Память под кадры всех живых поведений, байт
+std::size_t behavior_frame_bytes();
+
+// NPC глазами своего поведения: действия и ожидания. Ожидания можно
+// co_await-ить только в самой сопрограмме поведения, не во вложенных.
+class Agent {
+public:
+  Agent(BehaviorScheduler &_scheduler, entity_id _id) : scheduler(&_scheduler), self(_id) {}
+
+  struct TickAwaiter {
+    BehaviorScheduler *scheduler;
+    entity_id id;
+    std::uint64_t ticks;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const;
+    void await_resume() const noexcept {}
+  };
+
+  // Возвращает найденного NPC или kNoEntity по истечении timeout тиков
+  struct SenseAwaiter {
+    BehaviorScheduler *scheduler;
+    entity_id id;
+    std::uint8_t what;
+    int radius;
+    std::uint64_t timeout;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const;
+    entity_id await_resume() const;
+  };
+
+  entity_id id() const { return self; }
+  World &world() const;
+  int x() const { return world().x[self]; }
+  int y() const { return world().y[self]; }
+  std::uint64_t tick() const;
+
+  // Жив ли other и не дальше ли он distance
+  bool near(entity_id other, int distance) const;
+
+  // Шаги на дистанцию хода NPC; карта ограничивает их так же, как случайный шаг
+  // dx, dy в {-1, 0, 1}
+  void step(int dx, int dy);
+  void step_towards(entity_id other);
+  void step_away(entity_id other);
+  // Случайный шаг, тот же, что сделал бы MovementSystem
+  void wander();
+
+  // Следующий тик или через ticks тиков
+  TickAwaiter next_tick() const { return {scheduler, self, 1}; }
+  TickAwaiter sleep(std::uint64_t ticks) const { return {scheduler, self, ticks}; }
+  // Ближайший NPC вида what в радиусе radius (не больше радиуса планировщика).
+  // Проверка идёт по позициям на начало тика.
+  SenseAwaiter sense(std::uint8_t what, int radius, std::uint64_t timeout = kForever) const {
+    return {scheduler, self, what, radius, timeout};
+  }
+
+private:
+  BehaviorScheduler *scheduler;
+  entity_id self;
+};
+
+// Кооперативный планировщик поведений. Спящие по таймеру лежат в колесе
+// тиков, ждущие датчика проверяются раз за тик по сетке мира (параллельно,
+// если есть пул). Сработавшие возобновляются по одному в порядке id, поэтому
+// при одинаковом seed результат тот же при любом числе потоков.
+//
+// NPC с поведением не получает случайный шаг MovementSystem. Поведение
+// погибшего NPC уничтожается, когда планировщик до него доходит.
+class BehaviorScheduler {
+public:
+  static constexpr int kDefaultSenseRadius = 100;
+
+  BehaviorScheduler(World &world, int max_x, int max_y, std::uint64_t seed, ThreadPool *pool = nullptr,
+                    int sense_radius = kDefaultSenseRadius);
+  ~BehaviorScheduler();
+
+  BehaviorScheduler(const BehaviorScheduler &) = delete;
+  BehaviorScheduler &operator=(const BehaviorScheduler &) = delete;
+
+  // Прежнее поведение NPC уничтожается; новое стартует на ближайшем run
+  void attach(entity_id id, Behavior behavior);
+  void detach(entity_id id);
+
+  // Возобновляет поведения, чьи ожидания сработали на тике tick,
+  // возвращает число возобновлений. Вызывается владельцем мира до движения.
+  std::size_t run(std::uint64_t tick);
+
+  std::uint64_t get_tick() const { return now; }
+  int get_sense_radius() const { return sense_radius; }
+  std::size_t attached() const { return attached_count; }
+  std::size_t watching() const { return watchers.size(); }
+
+  void set_metrics(Metrics *_metrics) { metrics = _metrics; }
+
+private:
+  friend class Agent;
+  friend struct Agent::TickAwaiter;
+  friend struct Agent::SenseAwaiter;
+
+  static constexpr std::size_t kWheelSize = 256;
+
+  World &world;
+  int max_x;
+  int max_y;
+  std::uint64_t seed;
+  int sense_radius;
+  ThreadPool *pool;
+  Metrics *metrics = nullptr;
+  std::uint64_t now = 0;
+  std::size_t attached_count = 0;
+
+  // По id NPC; owner - поколение слота при attach
+  std::vector<std::coroutine_handle<>> handles;
+  std::vector<std::uint32_t> owner;
+  std::vector<std::uint64_t> wake_at;
+  std::vector<std::uint8_t> sense_what;
+  std::vector<int> sense_range;
+  std::vector<std::uint8_t> watch_listed;
+  std::vector<entity_id> found;
+
+  // Колесо таймеров: ячейка tick % kWheelSize; запись, чей wake_at
+  // уже другой, устарела и пропускается
+  std::vector<std::vector<entity_id>> wheel;
+  std::vector<entity_id> starting;
+  std::vector<entity_id> watchers;
+  std::vector<entity_id> due;
+  SpatialGrid grid;
+
+  void wait_ticks(entity_id id, std::uint64_t ticks);
+  void wait_sense(entity_id id, std::uint8_t what, int radius, std::uint64_t timeout);
+  void schedule(entity_id id, std::uint64_t tick);
+  void sense_watchers();
+  void finish(entity_id id);
+};
+
+// Поведения по умолчанию: драконы охотятся на пегасов, пегасы пасутся
+// и убегают от угрозы, рыцари патрулируют от точки появления и бьют
+// драконов, попавших в поле зрения
+Behavior hunt(Agent self);
+Behavior flee(Agent self);
+Behavior patrol(Agent self, int span);
+Behavior default_behavior(Agent self, NpcType type);
+
+// Вешает поведение по умолчанию на всех живых NPC мира
+void attach_default_behaviors(BehaviorScheduler &scheduler, World &world);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "metrics.hpp"
+#include "movement.hpp"
+#include "thread_pool.hpp"
+#include "world.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Пара NPC на тике без учёта направления: кандидаты (i, j) и (j, i)
+// сливаются в одну встречу, reach говорит, кто до кого достаёт
+struct FightPair {
+  static constexpr std::uint8_t kReachAB = 1; // a в радиусе убийства до b
+  static constexpr std::uint8_t kReachBA = 2;
+
+  entity_id a; // a < b
+  entity_id b;
+  std::uint8_t reach;
+};
+
+// Встреча: оба бросают кубик, больший бьёт, если достаёт; ничья -
+// расходятся. fought == false - боя не было.
+struct Encounter {
+  entity_id attacker;
+  entity_id defender;
+  bool fought;
+};
+
+// Поток кубиков боёв тика; кубики пары зависят только от него и от пары
+std::uint64_t fight_stream(std::uint64_t seed, std::uint64_t tick);
+Encounter roll_encounter(std::uint64_t stream, const FightPair &pair);
+
+// Бои тика пачкой. Пары раскладываются по раундам жадно в порядке (a, b)
+// так, что в раунде никто не встречается дважды. Раунд судится
+// параллельно: проверка жизни, кубики и таблица правил - в задачах пула,
+// каждая со своим буфером боёв. Буферы сливаются по порядку пар, и уже
+// в вызывающем потоке идут уведомления и гибель, поэтому исход зависит
+// только от seed, но не от числа потоков. Пара, участник которой погиб
+// в одном из прошлых раундов, пропускается.
+class CombatBatch {
+public:
+  // Раунд короче этого считается в вызывающем потоке
+  static constexpr std::size_t kParallelRound = 4096;
+
+  // Пары из кандидатов тика, упорядоченных по (attacker, defender)
+  void build(const std::vector<FightCandidate> &candidates);
+
+  // Проводит бои, возвращает число убийств; id погибших дописываются в killed
+  std::size_t resolve(World &world, std::vector<std::shared_ptr<NPC>> &npcs, std::uint64_t seed,
+                      std::uint64_t tick, ThreadPool *pool = nullptr, Metrics *metrics = nullptr,
+                      std::vector<entity_id> *killed = nullptr);
+
+  const std::vector<FightPair> &get_pairs() const { return pairs; }
+  std::size_t round_count() const { return round_begin.empty() ? 0 : round_begin.size() - 1; }
+  // Раунд пары get_pairs()[pair]
+  std::uint32_t get_round(std::size_t pair) const { return pair_round[pair]; }
+
+private:
+  std::vector<FightPair> pairs;
+  // Пары по раундам: раунд r - [round_begin[r], round_begin[r + 1]) в ordered
+  std::vector<std::uint32_t> ordered;
+  std::vector<std::size_t> round_begin;
+  std::vector<std::uint32_t> pair_round;
+  // Номер участника с 1 по id, 0 - не участвует; сбрасывается только для участников
+  std::vector<std::uint32_t> slot;
+  // Занятые раунды участников: слово w строки r - used[w * строк + r]
+  std::vector<std::uint64_t> used;
+
+  // Бой раунда, в котором оба участника были живы; win - защитник погибает
+  struct Fought {
+    Encounter encounter;
+    bool win;
+  };
+  // Буферы задач раунда, переиспользуются между раундами и тиками
+  std::vector<std::vector<Fought>> task_fights;
+};
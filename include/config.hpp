@@ -0,0 +1,27 @@
+#pragma once
+
+#include "simulation.hpp"
+
+#include <istream>
+#include <string>
+
+// Настройки прогона из текстового файла "ключ = значение", '#' - комментарий:
+//
+//   seed = 42
+//   npcs = 2000000
+//   map = 1000000 1000000
+//   ticks = 100
+//   threads = 8
+//   tile = 16384
+//   behaviors = 1
+//   dragon.move = 50
+//   dragon.kill = 30
+//
+// Ключи, которых нет в файле, остаются как были в config. Неизвестный ключ
+// или неверное значение - std::runtime_error с номером строки.
+void load_config(std::istream &is, SimulationConfig &config);
+void load_config_file(const std::string &path, SimulationConfig &config);
+
+// Пределы: размеры карты, тайл и дистанции в [0, kMaxCoordinate].
+// Нарушение - std::runtime_error.
+void validate_config(const SimulationConfig &config);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Пакетная проверка дистанции: один атакующий против блока кандидатов.
+// Координаты неотрицательные, меньше 2^26 (точность SSE2-пути на double).
+
+// Наибольшая допустимая координата и дистанция; квадрат разности таких
+// координат ещё точно представим в double и не переполняет int64
+inline constexpr int kMaxCoordinate = (1 << 26) - 1;
+
+enum class SimdLevel { Scalar = 0, SSE2 = 1, AVX2 = 2 };
+
+// Лучший уровень, поддерживаемый процессором
+SimdLevel detected_simd_level();
+SimdLevel get_simd_level();
+// Для тестов и бенчмарков; уровень выше поддерживаемого понижается
+void set_simd_level(SimdLevel level);
+
+// Бит k установлен, если кандидат k в радиусе distance. n <= 64.
+std::uint64_t within_distance_mask(int ax, int ay, const int *xs, const int *ys,
+                                   std::size_t n, int distance);
+
+// Пишет в out индексы кандидатов в радиусе, возвращает их количество
+std::size_t within_distance(int ax, int ay, const int *xs, const int *ys,
+                            std::size_t n, int distance, std::uint32_t *out);
@@ -6,6 +6,7 @@ class Dragon : public NPC, public Visitor
 public:
     Dragon(int x, int y, const std::string& name);
     Dragon(std::istream& is);
+    Dragon(World& world, std::uint32_t id);
 
     void print() override;
     void save(std::ostream& os) override;
@@ -14,9 +15,6 @@ public:
     bool visit(Knight& other) override;
     bool visit(Dragon& other) override;
     bool visit(Pegasus& other) override;
-    
-    int get_move_distance() const override { return 50; }
-    int get_kill_distance() const override { return 30; }
 
     friend std::ostream& operator<<(std::ostream& os, Dragon& dragon);
 };
\ No newline at end of file
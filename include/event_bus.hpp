@@ -0,0 +1,90 @@
+#pragma once
+
+#include "npc.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum class FightKind : std::uint8_t { Kill = 1, Fight = 2 };
+
+// Итог одного боя. Участники - индексы в мире, без владеющих указателей.
+struct FightOutcome {
+  std::uint64_t tick;
+  std::uint32_t attacker;
+  std::uint32_t defender;
+  NpcType attacker_type;
+  NpcType defender_type;
+  FightKind kind;
+};
+
+// Фильтр подписки: маски видов событий и типов NPC, бит - значение enum
+struct EventFilter {
+  static constexpr std::uint32_t kAnyType = ~0u;
+
+  std::uint8_t kinds = std::uint8_t(FightKind::Kill) | std::uint8_t(FightKind::Fight);
+  std::uint32_t attacker_types = kAnyType;
+  std::uint32_t defender_types = kAnyType;
+
+  static EventFilter only(FightKind kind);
+
+  bool accepts_all() const;
+  bool matches(const FightOutcome &event) const {
+    return (kinds & std::uint8_t(event.kind)) && (attacker_types >> event.attacker_type & 1u) &&
+           (defender_types >> event.defender_type & 1u);
+  }
+};
+
+class IEventObserver {
+public:
+  // Все подходящие под фильтр события тика одним вызовом
+  virtual void on_events(const std::vector<FightOutcome> &events) = 0;
+  virtual ~IEventObserver() = default;
+};
+
+// Общая шина событий мира. Наблюдатель подписывается один раз на весь мир,
+// бои копятся в буфер и раздаются пачкой в dispatch, обычно раз за тик.
+// Стоимость раздачи зависит от числа событий и подписчиков, но не от числа NPC.
+class EventBus {
+public:
+  using SubscriptionId = std::size_t;
+
+  SubscriptionId subscribe(std::shared_ptr<IEventObserver> observer, EventFilter filter = {});
+  void unsubscribe(SubscriptionId id);
+
+  // Тик, которым помечаются новые события
+  void set_tick(std::uint64_t tick) { current_tick.store(tick, std::memory_order_relaxed); }
+
+  void post(std::uint32_t attacker, std::uint32_t defender, NpcType attacker_type,
+            NpcType defender_type, bool win);
+
+  // Раздаёт накопленное подписчикам, возвращает число событий. Вызывается
+  // из одного потока; подписываться из обработчика нельзя.
+  std::size_t dispatch();
+
+  std::size_t pending() const;
+  bool has_subscribers() const { return subscriber_count.load(std::memory_order_relaxed) > 0; }
+
+private:
+  struct Subscription {
+    SubscriptionId id;
+    std::shared_ptr<IEventObserver> observer;
+    EventFilter filter;
+  };
+
+  std::atomic<std::uint64_t> current_tick{0};
+  std::atomic<std::size_t> subscriber_count{0};
+
+  mutable std::mutex pending_mutex;
+  std::vector<FightOutcome> queued;
+
+  std::mutex subscribers_mutex;
+  std::vector<Subscription> subscribers;
+  SubscriptionId next_id = 0;
+
+  // Буферы раздачи, переиспользуются между тиками
+  std::vector<FightOutcome> delivering;
+  std::vector<FightOutcome> filtered;
+};
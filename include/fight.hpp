@@ -0,0 +1,9 @@
+#pragma once
+
+#include "npc.hpp"
+
+#include <memory>
+
+// Исход боя по таблице правил без двойной диспетчеризации; уведомляет
+// наблюдателей атакующего так же, как visit. true - защитник убит.
+bool resolve_fight(const std::shared_ptr<NPC> &attacker, const std::shared_ptr<NPC> &defender);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Неизменяемая копия состояния мира на конец тика
+struct WorldFrame {
+  std::uint64_t tick = 0;
+  std::vector<int> x;
+  std::vector<int> y;
+  std::vector<NpcType> type;
+  std::vector<std::uint8_t> alive;
+  std::vector<std::uint32_t> generation;
+  // Живые id: печать обходит их, а не все слоты
+  std::vector<entity_id> active;
+  std::size_t alive_count = 0;
+
+  std::size_t size() const { return type.size(); }
+};
+
+// Двойной буфер кадров. Владелец мира публикует кадр между тиками,
+// читатели (печать карты, статистика) берут последний опубликованный кадр
+// и читают его без блокировок мира. Пока кто-то держит старый кадр,
+// публикация пропускается, а не ждёт читателя.
+class FrameBuffer {
+  struct Slot {
+    WorldFrame frame;
+    std::atomic<int> readers{0};
+  };
+
+public:
+  class Handle {
+  public:
+    Handle(Handle &&other) noexcept : slot(other.slot) { other.slot = nullptr; }
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+    ~Handle();
+
+    const WorldFrame &operator*() const { return slot->frame; }
+    const WorldFrame *operator->() const { return &slot->frame; }
+
+  private:
+    friend class FrameBuffer;
+    explicit Handle(Slot *_slot) : slot(_slot) {}
+
+    Slot *slot;
+  };
+
+  // Вызывается только владельцем мира; false - кадр пропущен
+  bool publish(const World &world, std::uint64_t tick);
+  Handle acquire() const;
+
+  std::uint64_t published() const { return published_count.load(std::memory_order_relaxed); }
+  std::uint64_t skipped() const { return skipped_count.load(std::memory_order_relaxed); }
+
+private:
+  mutable Slot slots[2];
+  mutable std::mutex mutex;
+  int front = 0;
+
+  std::atomic<std::uint64_t> published_count{0};
+  std::atomic<std::uint64_t> skipped_count{0};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "distance.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Равномерная сетка для поиска соседей. Размер ячейки должен быть не меньше
+// максимальной дистанции убийства, тогда все кандидаты лежат в 3x3 ячейках.
+// Сетка покрывает прямоугольник [min_x, max_x] x [min_y, max_y]; на больших
+// картах ячейки укрупняются, чтобы их было не больше max_cells.
+class SpatialGrid {
+public:
+  static constexpr std::size_t kMaxCells = 1 << 20;
+
+  SpatialGrid(int cell_size, int max_x, int max_y, int min_x = 0, int min_y = 0,
+              std::size_t max_cells = kMaxCells);
+
+  void clear();
+  void insert(std::size_t id, int x, int y);
+  void remove(std::size_t id, int x, int y);
+  void update(std::size_t id, int old_x, int old_y, int new_x, int new_y);
+
+  int get_cell_size() const { return cell_size; }
+  std::size_t size() const { return count; }
+
+  template <class F> void for_each_near(int x, int y, F &&fn) const {
+    for_each_cell(x, y, [&](const Cell &cell) {
+      for (std::size_t id : cell.ids)
+        fn(id);
+    });
+  }
+
+  // Только кандидаты в радиусе distance, проверка пакетами по 64.
+  // Возвращает число проверенных пар.
+  template <class F> std::size_t for_each_within(int x, int y, int distance, F &&fn) const {
+    std::size_t tested = 0;
+    for_each_cell(x, y, [&](const Cell &cell) {
+      std::size_t n = cell.ids.size();
+      tested += n;
+      for (std::size_t base = 0; base < n; base += 64) {
+        std::size_t block = std::min<std::size_t>(64, n - base);
+        std::uint64_t mask = within_distance_mask(x, y, cell.xs.data() + base,
+                                                  cell.ys.data() + base, block, distance);
+        while (mask) {
+          fn(cell.ids[base + __builtin_ctzll(mask)]);
+          mask &= mask - 1;
+        }
+      }
+    });
+    return tested;
+  }
+
+private:
+  // Позиции хранятся рядом с id, чтобы ядро дистанции шло по непрерывной памяти
+  struct Cell {
+    std::vector<std::size_t> ids;
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bool listed = false;
+  };
+
+  int cell_size;
+  int min_x;
+  int min_y;
+  int cols;
+  int rows;
+  std::size_t count = 0;
+  std::vector<Cell> cells;
+  // Ячейки, в которые что-то вставляли после clear: очистка не обходит пустые
+  std::vector<int> occupied;
+
+  int cell_x(int x) const { return std::max(0, std::min(cols - 1, (x - min_x) / cell_size)); }
+  int cell_y(int y) const { return std::max(0, std::min(rows - 1, (y - min_y) / cell_size)); }
+  int cell_of(int x, int y) const { return cell_y(y) * cols + cell_x(x); }
+
+  template <class F> void for_each_cell(int x, int y, F &&fn) const {
+    int cx = cell_x(x);
+    int cy = cell_y(y);
+    for (int gy = std::max(0, cy - 1); gy <= std::min(rows - 1, cy + 1); ++gy) {
+      for (int gx = std::max(0, cx - 1); gx <= std::min(cols - 1, cx + 1); ++gx)
+        fn(cells[gy * cols + gx]);
+    }
+  }
+};
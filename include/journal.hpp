@@ -0,0 +1,113 @@
+#pragma once
+
+#include "metrics.hpp"
+#include "snapshot.hpp"
+#include "world.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Контрольные точки: полный снимок раз в несколько тиков плюс журнал
+// изменений за каждый тик. Каталог контрольных точек:
+//
+//   snapshot-<tick>.bin - снимок (snapshot.hpp) мира после tick тиков
+//   journal-<tick>.bin  - блоки изменений тиков после tick, только дописываются
+//
+// Блок - заголовок JournalBlockHeader и тело из трёх частей: смерти,
+// рождения и сдвиги за тик. В каждой части число записей, затем записи по
+// возрастанию id: разность id с прошлой записью, для смертей и рождений
+// тип, затем координаты, для рождений ещё имя. Смерть NPC, родившегося в
+// том же тике, тоже несёт имя и помечается старшим битом типа. Числа -
+// varint, координаты в zigzag. Блок несёт итоговое состояние NPC на конец тика, поэтому
+// порядок частей при повторе не важен.
+struct JournalBlockHeader {
+  char magic[4];
+  std::uint32_t size; // байт тела
+  std::uint64_t tick;
+  std::uint64_t checksum; // хеш тела
+};
+
+constexpr char kJournalMagic[4] = {'D', 'N', 'G', 'J'};
+
+// Блок изменений за тик tick в out (заголовок и тело)
+void encode_journal_block(const World &world, const WorldChanges &changes, std::uint64_t tick,
+                          std::string &out);
+
+struct CheckpointStats {
+  std::uint64_t blocks = 0;
+  std::uint64_t journal_bytes = 0;
+  // Полностью записанные фоновые снимки, без начального
+  std::uint64_t snapshots = 0;
+  // Тик последнего снимка на диске
+  std::uint64_t snapshot_tick = 0;
+};
+
+// Пишет контрольные точки мира в каталог. Конструктор синхронно кладёт
+// начальный снимок и убирает из каталога всё остальное. Дальше владелец
+// мира после каждого тика зовёт commit: изменения тика дописываются в
+// журнал, а раз в snapshot_every тиков мир копируется в память и пишется
+// снимком в фоновом потоке. Пока прошлый снимок пишется, новый не
+// начинается. Стоимость commit - O(изменений тика) на журнал плюс проход
+// по active_ids в поисках сдвинутых; копия для снимка - O(мира), но без
+// ввода-вывода.
+//
+// Снимок пишется во временный файл и переименовывается, после чего
+// старые снимки и журналы до него удаляются. Журнал сбрасывается в ОС на
+// каждом commit, поэтому падение процесса теряет не больше недописанного
+// блока. fsync не делается: от потери питания это не защищает.
+class Checkpointer {
+public:
+  Checkpointer(World &world, const std::string &dir, std::uint64_t snapshot_every, std::uint64_t tick = 0);
+  ~Checkpointer();
+
+  Checkpointer(const Checkpointer &) = delete;
+  Checkpointer &operator=(const Checkpointer &) = delete;
+
+  // После тика: tick - число пройденных тиков. Ошибка фоновой записи
+  // всплывает здесь же std::runtime_error.
+  void commit(std::uint64_t tick);
+  // Ждёт, пока начатый снимок окажется на диске
+  void wait();
+
+  CheckpointStats stats() const;
+  void set_metrics(Metrics *_metrics) { metrics = _metrics; }
+
+private:
+  World &world;
+  std::string dir;
+  std::uint64_t snapshot_every;
+  std::uint64_t snapshot_tick;
+  Metrics *metrics = nullptr;
+
+  WorldChanges changes;
+  std::string block;
+  std::ofstream journal;
+  std::string journal_path;
+
+  // Фоновый писатель: image занят им, пока busy
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  SnapshotImage image;
+  std::uint64_t image_tick = 0;
+  bool busy = false;
+  bool stop = false;
+  std::exception_ptr error;
+  CheckpointStats counters;
+  std::thread writer;
+
+  void open_journal(std::uint64_t tick);
+  void writer_loop();
+};
+
+// Восстанавливает мир из каталога: последний целый снимок и затем блоки
+// журналов по порядку тиков. Повтор останавливается на первом оборванном
+// или испорченном блоке - это хвост, недописанный при падении. Мир должен
+// быть пуст, дистанции по типу - уже настроены. Возвращает число тиков, на
+// котором остановился мир. Нет снимка - std::runtime_error.
+std::uint64_t recover(World &world, const std::string &dir);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "metrics.hpp"
+#include "npc.hpp"
+#include "world.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class LogEvent : std::uint8_t { Kill = 1, Fight = 2 };
+
+struct LogRecord {
+  std::uint64_t tick;
+  entity_id attacker;
+  entity_id defender;
+  LogEvent event;
+};
+
+// Что делать, когда кольцевой буфер потока заполнен
+enum class OverflowPolicy { Drop, Block };
+
+// Асинхронный журнал боёв. Каждый поток-производитель пишет компактные
+// записи в свой кольцевой буфер без блокировок; фоновый поток собирает их,
+// форматирует по именам из World и пишет в приёмники большими пачками.
+class AsyncLogger {
+public:
+  struct Options {
+    std::size_t ring_capacity = 1 << 14;
+    OverflowPolicy overflow = OverflowPolicy::Drop;
+    std::chrono::milliseconds flush_interval{50};
+    // Таймер Log - запись пачки фоновым потоком
+    Metrics *metrics = nullptr;
+  };
+
+  AsyncLogger(const World &world, Options options);
+  ~AsyncLogger();
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+  // guard - мьютекс, под которым пишут в этот же поток вывода другие
+  void add_sink(std::ostream &os, std::mutex *guard = nullptr);
+
+  void log(LogEvent event, std::uint64_t tick, entity_id attacker, entity_id defender);
+
+  // Ждёт, пока всё записанное до вызова окажется в приёмниках
+  void flush();
+
+  std::uint64_t written() const { return written_count.load(std::memory_order_relaxed); }
+  std::uint64_t dropped() const { return dropped_count.load(std::memory_order_relaxed); }
+
+private:
+  struct Ring;
+  struct Sink {
+    std::ostream *os;
+    std::mutex *guard;
+  };
+
+  const World &world;
+  Options options;
+  std::uint64_t instance;
+
+  std::mutex rings_mutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::vector<Sink> sinks;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable flushed;
+  bool stopping = false;
+  std::uint64_t flush_requested = 0;
+  std::uint64_t flush_completed = 0;
+
+  std::atomic<std::uint64_t> written_count{0};
+  std::atomic<std::uint64_t> dropped_count{0};
+  std::thread writer;
+
+  Ring &local_ring();
+  void writer_loop();
+  std::size_t drain(std::vector<LogRecord> &out);
+  void write_batch(const std::vector<LogRecord> &records, const std::vector<Sink> &targets);
+};
+
+// Подписчик шины, который только кладёт записи о боях в журнал.
+// Подписывается с фильтром EventFilter::only(FightKind::Kill).
+class LogObserver : public IEventObserver {
+public:
+  explicit LogObserver(AsyncLogger &logger);
+
+  void on_events(const std::vector<FightOutcome> &events) override;
+
+private:
+  AsyncLogger &logger;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Фазы тика и задержки, которые копятся как гистограммы
+enum class Timer : std::uint8_t {
+  Behave,
+  Move,
+  Detect,
+  Fight,
+  Notify,
+  Log,
+  Checkpoint,
+  Count
+};
+
+enum class Counter : std::uint8_t { PairsTested, FightsResolved, Kills, Count };
+
+const char *timer_name(Timer timer);
+const char *counter_name(Counter counter);
+
+struct TimerStats {
+  // Корзина b - длительности с b значащими битами в наносекундах
+  static constexpr std::size_t kBuckets = 40;
+
+  std::uint64_t count = 0;
+  std::uint64_t total_ns = 0;
+  std::uint64_t max_ns = 0;
+  std::array<std::uint64_t, kBuckets> buckets{};
+
+  // Верхняя граница корзины, в которую попадает квантиль q
+  std::uint64_t quantile_ns(double q) const;
+};
+
+struct MetricsSnapshot {
+  std::array<std::uint64_t, std::size_t(Counter::Count)> counters{};
+  std::array<TimerStats, std::size_t(Timer::Count)> timers{};
+
+  std::uint64_t counter(Counter c) const { return counters[std::size_t(c)]; }
+  const TimerStats &timer(Timer t) const { return timers[std::size_t(t)]; }
+};
+
+// Счётчики и таймеры. Каждый поток пишет в свой блок без атомарных
+// read-modify-write, snapshot складывает блоки всех потоков при чтении.
+// Дёшево настолько, что включено всегда.
+class Metrics {
+public:
+  Metrics();
+  ~Metrics();
+
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  void add(Counter counter, std::uint64_t n = 1);
+  void record(Timer timer, std::chrono::nanoseconds duration);
+
+  MetricsSnapshot snapshot() const;
+  // Блоков потоков: по одному на каждый поток, писавший в этот экземпляр
+  std::size_t block_count() const;
+
+  // Замер фазы от конструктора до деструктора; с nullptr ничего не делает
+  class Scope {
+  public:
+    Scope(Metrics *_metrics, Timer _timer)
+        : metrics(_metrics), timer(_timer),
+          start(metrics ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}) {}
+    ~Scope() {
+      if (metrics)
+        metrics->record(timer, std::chrono::steady_clock::now() - start);
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Metrics *metrics;
+    Timer timer;
+    std::chrono::steady_clock::time_point start;
+  };
+
+private:
+  struct Block;
+
+  std::uint64_t instance;
+  mutable std::mutex blocks_mutex;
+  std::vector<std::unique_ptr<Block>> blocks;
+
+  Block &local_block();
+};
+
+// Одна строка JSON на снимок - для дописывания в файл раз в период
+void write_metrics_json(std::ostream &os, const MetricsSnapshot &snapshot, std::uint64_t tick);
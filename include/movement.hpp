@@ -0,0 +1,75 @@
+#pragma once
+
+#include "metrics.hpp"
+#include "thread_pool.hpp"
+#include "tiles.hpp"
+#include "world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct FightCandidate {
+  entity_id attacker;
+  entity_id defender;
+};
+
+// Фаза движения и поиска боёв. Движение делится на блоки по kChunkSize живых NPC,
+// блоки разбирает пул потоков. Шаг NPC зависит только от seed, номера тика
+// и его id (move_direction), а не от соседей по блоку. Поиск пар идёт по тайлам
+// карты (tiles.hpp), кандидаты упорядочиваются по (attacker, defender) -
+// результат не зависит ни от числа потоков, ни от размера тайла.
+class MovementSystem {
+public:
+  static constexpr std::size_t kChunkSize = 1024;
+
+  // tile_size <= 0 - TileMap::kDefaultTileSize
+  MovementSystem(World &world, int max_x, int max_y, std::uint64_t seed,
+                 ThreadPool *pool = nullptr, int tile_size = 0);
+
+  // Вызывается владельцем мира; другие потоки в это время мир не трогают
+  const std::vector<FightCandidate> &tick();
+
+  std::uint64_t get_tick() const { return tick_index; }
+  // Следующим будет тик tick: продолжение прогона после восстановления
+  void set_tick(std::uint64_t tick) { tick_index = tick; }
+
+  // Таймеры фаз Move/Detect и счётчик проверенных пар
+  void set_metrics(Metrics *_metrics) { metrics = _metrics; }
+
+  const TileMap &get_tiles() const { return tiles; }
+
+private:
+  World &world;
+  int max_x;
+  int max_y;
+  std::uint64_t seed;
+  std::uint64_t tick_index = 0;
+  ThreadPool *pool;
+  Metrics *metrics = nullptr;
+
+  TileMap tiles;
+  // Задачи поиска пар: блок своих NPC одного тайла
+  struct DetectTask {
+    std::size_t tile;
+    std::size_t begin;
+  };
+  std::vector<DetectTask> detect_tasks;
+  std::vector<std::vector<FightCandidate>> task_candidates;
+  // Границы кандидатов разных тайлов в candidates перед слиянием
+  std::vector<std::size_t> tile_bounds;
+  std::vector<FightCandidate> candidates;
+
+  std::size_t chunk_count() const { return (world.active_ids().size() + kChunkSize - 1) / kChunkSize; }
+  void run(std::size_t tasks, const ThreadPool::Job &job);
+};
+
+std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t tick, std::uint64_t stream);
+
+// Направление шага NPC на тике: dx, dy в {-1, 0, 1}. stream - move_stream
+// тика; результат не зависит от того, кто ещё жив и кто считает шаг.
+std::uint64_t move_stream(std::uint64_t seed, std::uint64_t tick);
+void move_direction(std::uint64_t stream, entity_id id, int &dx, int &dy);
+
+// Сливает упорядоченные по (attacker, defender) отрезки candidates
+// [bounds[k], bounds[k + 1]) в один упорядоченный список
+void merge_candidate_runs(std::vector<FightCandidate> &candidates, const std::vector<std::size_t> &bounds);
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <math.h>
 #include <memory>
 #include <random>
@@ -13,6 +16,7 @@
 #include <shared_mutex>
 
 class NPC;
+class World;
 class Knight;
 class Dragon;
 class Pegasus;
@@ -21,6 +25,24 @@ using set_t = std::set<std::shared_ptr<NPC>>;
 
 enum NpcType { Unknown = 0, KnightType = 1, DragonType = 2, PegasusType = 3 };
 
+struct NpcTraits {
+  int move_distance;
+  int kill_distance;
+};
+
+// Дистанции хода и убийства по типу, индекс - NpcType
+inline constexpr NpcTraits npc_traits[] = {{0, 0}, {30, 10}, {50, 30}, {30, 10}};
+
+// Таблица дистанций, которую можно менять (конфиг, World::set_traits)
+using TraitsTable = std::array<NpcTraits, std::size(npc_traits)>;
+
+constexpr TraitsTable default_traits() {
+  TraitsTable table{};
+  for (std::size_t t = 0; t < table.size(); ++t)
+    table[t] = npc_traits[t];
+  return table;
+}
+
 class IFightObserver {
 public:
   virtual void on_fight(const std::shared_ptr<NPC> attacker,
@@ -36,22 +58,25 @@ public:
   virtual ~Visitor() = default;
 };
 
+// Ручка над сущностью мира. Аксессоры ничего не блокируют: пользоваться
+// ручкой может только текущий владелец мира (фаза тика или однопоточный код).
 class NPC : public std::enable_shared_from_this<NPC> {
 protected:
-  NpcType type;
-  int x;
-  int y;
-  std::string name;
+  World *world;
+  std::uint32_t id;
+  std::unique_ptr<World> own_world;
   std::vector<std::shared_ptr<IFightObserver>> observers;
-  bool alive;
-  mutable std::shared_mutex mutex;
 
+  // Ручка над сущностью в чужом мире
+  NPC(World &_world, std::uint32_t _id);
+  // Отдельный NPC со своим миром из одной сущности
   NPC(NpcType t, int _x, int _y, const std::string &_name);
   NPC(NpcType t, std::istream &is);
 
 public:
-  virtual ~NPC() = default;
+  virtual ~NPC();
 
+  // Подписка на бои одного NPC; общие наблюдатели подписываются на World::events
   void subscribe(std::shared_ptr<IFightObserver> observer);
   void fight_notify(const std::shared_ptr<NPC> defender, bool win);
   bool is_close(const std::shared_ptr<NPC> &other, size_t distance) const;
@@ -59,42 +84,19 @@ public:
   virtual bool accept(std::shared_ptr<NPC> attacker) = 0;
   virtual void print() = 0;
   virtual void save(std::ostream &os);
-  
-  virtual int get_move_distance() const = 0;
-  virtual int get_kill_distance() const = 0;
-
-  int get_x() const { 
-    std::shared_lock lock(mutex);
-    return x; 
-  }
-  
-  int get_y() const { 
-    std::shared_lock lock(mutex);
-    return y; 
-  }
-  
-  std::string get_name() const { 
-    std::shared_lock lock(mutex);
-    return name; 
-  }
-  
-  bool is_alive() const {
-    std::shared_lock lock(mutex);
-    return alive;
-  }
-  
-  void set_alive(bool status) {
-    std::lock_guard lock(mutex);
-    alive = status;
-  }
-  
-  void move(int dx, int dy, int max_x, int max_y) {
-    std::lock_guard lock(mutex);
-    if (!alive) return;
-    
-    x = std::max(0, std::min(max_x, x + dx));
-    y = std::max(0, std::min(max_y, y + dy));
-  }
+
+  World &get_world() const { return *world; }
+  std::uint32_t get_id() const { return id; }
+
+  NpcType get_type() const;
+  int get_move_distance() const;
+  int get_kill_distance() const;
+  int get_x() const;
+  int get_y() const;
+  std::string get_name() const;
+  bool is_alive() const;
+  void set_alive(bool status);
+  void move(int dx, int dy, int max_x, int max_y);
 
   friend std::ostream &operator<<(std::ostream &os, NPC &npc);
 };
\ No newline at end of file
@@ -6,6 +6,7 @@ class Pegasus : public NPC, public Visitor
 public:
     Pegasus(int x, int y, const std::string& name);
     Pegasus(std::istream& is);
+    Pegasus(World& world, std::uint32_t id);
 
     void print() override;
     void save(std::ostream& os) override;
@@ -14,9 +15,6 @@ public:
     bool visit(Knight& other) override;
     bool visit(Dragon& other) override;
     bool visit(Pegasus& other) override;
-    
-    int get_move_distance() const override { return 30; }
-    int get_kill_distance() const override { return 10; }
 
     friend std::ostream& operator<<(std::ostream& os, Pegasus& pegasus);
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "frame.hpp"
+#include "world.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class RenderMode {
+  List,    // все живые NPC с координатами
+  Density, // уменьшенная сетка плотности карты
+  Diff     // только NPC, изменившиеся с прошлого кадра
+};
+
+// Отрисовка кадра в текст. Всё собирается в один буфер, который вызывающий
+// пишет одним вызовом; сам рендер не берёт никаких блокировок. Имена читаются
+// из World - если мир может рождать NPC, вызывающий держит его блокировку.
+class MapRenderer {
+public:
+  MapRenderer(RenderMode mode, int max_x, int max_y, int columns = 64, int rows = 24);
+
+  // Дописывает отрисовку кадра в out
+  void render(const WorldFrame &frame, const World &world, std::string &out);
+
+  RenderMode get_mode() const { return mode; }
+
+private:
+  RenderMode mode;
+  int max_x;
+  int max_y;
+  int columns;
+  int rows;
+
+  std::vector<std::uint32_t> density;
+
+  // Состояние прошлого кадра для режима Diff
+  bool has_previous = false;
+  std::vector<int> prev_x;
+  std::vector<int> prev_y;
+  std::vector<std::uint8_t> prev_alive;
+  std::vector<std::uint32_t> prev_generation;
+
+  void render_list(const WorldFrame &frame, const World &world, std::string &out);
+  void render_density(const WorldFrame &frame, std::string &out);
+  void render_diff(const WorldFrame &frame, const World &world, std::string &out);
+};
+
+// Разбор имени режима из командной строки; false - неизвестное имя
+bool parse_render_mode(const std::string &name, RenderMode &mode);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "npc.hpp"
+
+#include <array>
+#include <iterator>
+
+struct KillRule {
+  NpcType attacker;
+  NpcType defender;
+};
+
+// Кто кого убивает. Единственное место, где заданы правила боя:
+// таблица, посетители и движок боёв строятся по этому списку.
+inline constexpr KillRule kill_rules[] = {
+    {KnightType, DragonType},
+    {DragonType, PegasusType},
+};
+
+inline constexpr std::size_t kNpcTypeCount = std::size(npc_traits);
+
+using FightTable = std::array<std::array<bool, kNpcTypeCount>, kNpcTypeCount>;
+
+constexpr FightTable make_fight_table() {
+  FightTable table{};
+  for (const auto &rule : kill_rules)
+    table[rule.attacker][rule.defender] = true;
+  return table;
+}
+
+inline constexpr FightTable fight_table = make_fight_table();
+
+constexpr bool can_kill(NpcType attacker, NpcType defender) {
+  return fight_table[attacker][defender];
+}
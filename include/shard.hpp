@@ -0,0 +1,69 @@
+#pragma once
+
+#include "simulation.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <sys/types.h>
+
+struct ShardStats {
+  std::uint64_t bytes_sent = 0;     // координатор -> шарды
+  std::uint64_t bytes_received = 0; // шарды -> координатор
+  std::uint64_t migrated = 0;       // NPC, сменившие шард
+  std::uint64_t guests = 0;         // копий NPC у соседей через границу
+};
+
+// Симуляция, разнесённая по процессам. Карта режется на вертикальные полосы,
+// каждую ведёт свой рабочий процесс: двигает своих NPC и ищет для них пары.
+// Координатор на каждом тике пересылает через Unix-сокеты перешедших границу
+// NPC и копии NPC у границы (гостей), сливает кандидатов шардов и проводит
+// бои так же, как Simulation::step, рассылая погибших на следующем тике.
+// При одинаковом seed результат совпадает с однопроцессным прогоном.
+//
+// Рабочие процессы отделяются fork-ом от уже заполненного мира; позиции
+// чужих NPC в их копиях устаревают и не используются. Между процессами
+// ходят только сообщения, поэтому транспорт можно сменить на TCP.
+class ShardCoordinator {
+public:
+  // shards урезается так, чтобы полоса была не уже дистанции убийства
+  ShardCoordinator(World &world, std::vector<std::shared_ptr<NPC>> &npcs,
+                   const SimulationConfig &config, std::size_t shards);
+  ~ShardCoordinator();
+
+  ShardCoordinator(const ShardCoordinator &) = delete;
+  ShardCoordinator &operator=(const ShardCoordinator &) = delete;
+
+  // Один тик, возвращает число убийств
+  std::size_t step();
+  // Переносит позиции из шардов в мир координатора (для хеша, отчёта, сохранения)
+  void collect();
+
+  std::uint64_t get_tick() const { return tick; }
+  std::size_t shard_count() const { return workers.size(); }
+  const ShardStats &stats() const { return totals; }
+
+  void set_metrics(Metrics *_metrics) { metrics = _metrics; }
+
+private:
+  struct Worker {
+    pid_t pid;
+    int fd;
+  };
+
+  World &world;
+  std::vector<std::shared_ptr<NPC>> &npcs;
+  std::uint64_t seed;
+  int strip_width;
+  int halo;
+  std::uint64_t tick = 0;
+  std::vector<Worker> workers;
+  std::vector<entity_id> deaths;
+  std::vector<FightCandidate> candidates;
+  CombatBatch combat;
+  ShardStats totals;
+  Metrics *metrics = nullptr;
+
+  void shutdown();
+};
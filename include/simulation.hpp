@@ -0,0 +1,111 @@
+#pragma once
+
+#include "behavior.hpp"
+#include "combat.hpp"
+#include "journal.hpp"
+#include "movement.hpp"
+#include "spatial_index.hpp"
+#include "npc.hpp"
+#include "world.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Параметры прогона; из файла читаются через load_config (config.hpp).
+// Дистанции попадают в мир через configure_world - до populate и до
+// создания Simulation/MovementSystem, которые берут из мира ширину гостевой полосы.
+struct SimulationConfig {
+  std::uint64_t seed = 0;
+  std::size_t npc_count = 50;
+  int max_x = 100;
+  int max_y = 100;
+  std::uint64_t ticks = 1000;
+  std::size_t threads = 1;
+  // Сторона тайла карты, 0 - TileMap::kDefaultTileSize
+  int tile_size = 0;
+  // Поведения по умолчанию (behavior.hpp) вместо случайного шага
+  bool behaviors = false;
+  // Номер первого тика: продолжение прогона после recover (journal.hpp)
+  std::uint64_t start_tick = 0;
+  // Каталог контрольных точек, пусто - без них. Состояние поведений в
+  // контрольные точки не попадает, вместе с behaviors их не включают.
+  std::string checkpoint_dir;
+  // Тиков между полными снимками
+  std::uint64_t checkpoint_every = 100;
+  // Дистанции хода и убийства по типу, индекс - NpcType
+  TraitsTable traits = default_traits();
+};
+
+void configure_world(World &world, const SimulationConfig &config);
+
+std::shared_ptr<NPC> make_handle(World &world, entity_id id);
+std::shared_ptr<NPC> create_npc(World &world, NpcType type, int x, int y, const std::string &name);
+std::string generate_name(NpcType type, int index);
+
+// Состав населения для spawn_population: тип по весам weights[NpcType],
+// позиция равномерно по карте [0, max_x] x [0, max_y]
+struct PopulationSpec {
+  std::size_t count = 0;
+  int max_x = 100;
+  int max_y = 100;
+  std::uint64_t seed = 0;
+  std::array<std::uint32_t, std::size(npc_traits)> weights = {0, 1, 1, 1};
+};
+
+// Массовая расстановка через World::spawn_bulk. NPC номер i зависит только
+// от seed и i, поэтому мир одинаков при любом числе потоков пула. NPC
+// занимают новые слоты после существующих, ручки ложатся в npcs по id.
+// Возвращает id первого.
+entity_id spawn_population(World &world, std::vector<std::shared_ptr<NPC>> &npcs, const PopulationSpec &spec,
+                           ThreadPool *pool = nullptr);
+
+// Случайная расстановка поровну по типам, зависит только от seed
+void populate(World &world, std::vector<std::shared_ptr<NPC>> &npcs, std::size_t count,
+              int max_x, int max_y, std::uint64_t seed, ThreadPool *pool = nullptr);
+
+// Хеш позиций и флагов жизни - для сравнения прогонов
+std::uint64_t world_hash(const World &world);
+
+// Детерминированная симуляция с фиксированным шагом: движение, поиск пар
+// и бои идут дискретными тиками без пауз. При одинаковом seed результат
+// совпадает побайтно при любом числе потоков.
+class Simulation {
+public:
+  Simulation(World &world, std::vector<std::shared_ptr<NPC>> &npcs,
+             const SimulationConfig &config, ThreadPool *pool = nullptr);
+
+  // Один тик, возвращает число убийств
+  std::size_t step();
+
+  std::uint64_t get_tick() const { return movement.get_tick(); }
+  // nullptr, если поведения выключены в конфиге
+  BehaviorScheduler *get_behaviors() { return behaviors.get(); }
+  // nullptr без каталога контрольных точек в конфиге
+  Checkpointer *get_checkpoints() { return checkpoints.get(); }
+
+  // Пространственные запросы по миру на текущий тик. Индекс обновляется
+  // при первом обращении за тик: refit, а раз в kIndexRebuildTicks тиков
+  // или после рождений - полная перестройка.
+  static constexpr std::uint64_t kIndexRebuildTicks = 8;
+  const SpatialIndex &spatial();
+
+  void set_metrics(Metrics *_metrics);
+
+private:
+  World &world;
+  std::vector<std::shared_ptr<NPC>> &npcs;
+  std::uint64_t seed;
+  ThreadPool *pool;
+  MovementSystem movement;
+  CombatBatch combat;
+  std::unique_ptr<BehaviorScheduler> behaviors;
+  std::unique_ptr<Checkpointer> checkpoints;
+  SpatialIndex index;
+  bool index_ready = false;
+  std::uint64_t index_tick = 0;
+  std::uint64_t index_built = 0;
+  Metrics *metrics = nullptr;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Пул блоков одного размера: память берётся пластами по blocks_per_slab,
+// освобождённые блоки уходят в список свободных и выдаются повторно.
+class SlabPool {
+public:
+  SlabPool(std::size_t block_size, std::size_t blocks_per_slab = 4096);
+
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+
+  void *allocate();
+  void deallocate(void *block);
+
+  std::size_t get_block_size() const { return block_size; }
+  std::size_t slab_count() const;
+  std::size_t in_use() const;
+
+private:
+  struct FreeNode {
+    FreeNode *next;
+  };
+
+  std::size_t block_size;
+  std::size_t blocks_per_slab;
+
+  mutable std::mutex mutex;
+  FreeNode *free_list = nullptr;
+  std::vector<std::unique_ptr<std::byte[]>> slabs;
+  std::size_t used = 0;
+};
+
+// Аллокатор для std::allocate_shared: объект вместе с блоком управления
+// ложится в один блок пула. Что не помещается - идёт в обычную кучу.
+template <class T> class SlabAllocator {
+public:
+  using value_type = T;
+
+  explicit SlabAllocator(std::shared_ptr<SlabPool> _pool) : pool(std::move(_pool)) {}
+  template <class U> SlabAllocator(const SlabAllocator<U> &other) : pool(other.pool) {}
+
+  T *allocate(std::size_t n) {
+    if (fits(n))
+      return static_cast<T *>(pool->allocate());
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    if (fits(n))
+      pool->deallocate(p);
+    else
+      ::operator delete(p);
+  }
+
+  template <class U> bool operator==(const SlabAllocator<U> &other) const { return pool == other.pool; }
+  template <class U> bool operator!=(const SlabAllocator<U> &other) const { return pool != other.pool; }
+
+private:
+  template <class U> friend class SlabAllocator;
+
+  std::shared_ptr<SlabPool> pool;
+
+  bool fits(std::size_t n) const {
+    return n == 1 && sizeof(T) <= pool->get_block_size() && alignof(T) <= alignof(std::max_align_t);
+  }
+};
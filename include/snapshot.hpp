@@ -0,0 +1,88 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Бинарный снимок мира: заголовок, записи фиксированного размера по одной
+// на NPC и таблица строк с именами. Порядок байт - родной для машины.
+struct SnapshotHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t record_size;
+  std::uint64_t count;
+  std::uint64_t strings_offset;
+  std::uint64_t strings_size;
+};
+
+struct SnapshotRecord {
+  std::int32_t x;
+  std::int32_t y;
+  std::uint8_t type;
+  std::uint8_t alive;
+  std::uint16_t reserved;
+  std::uint32_t name_length;
+  std::uint64_t name_offset;
+};
+
+constexpr char kSnapshotMagic[8] = {'D', 'N', 'G', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint32_t kSnapshotVersion = 1;
+
+// Потоковая запись: записи и строки уходят блоками, без сброса на каждом поле
+void save_snapshot(const World &world, std::ostream &os);
+void save_snapshot(const World &world, const std::string &path);
+
+// Копия мира в формате снимка: владелец мира снимает её одним проходом по
+// массивам, а в файл она уходит позже из любого потока
+struct SnapshotImage {
+  std::vector<SnapshotRecord> records;
+  std::string strings;
+};
+void capture_snapshot(const World &world, SnapshotImage &image);
+void save_snapshot(const SnapshotImage &image, std::ostream &os);
+
+// Снимок, отображённый в память через mmap; записи читаются без копирования
+class SnapshotView {
+public:
+  explicit SnapshotView(const std::string &path);
+  ~SnapshotView();
+
+  SnapshotView(const SnapshotView &) = delete;
+  SnapshotView &operator=(const SnapshotView &) = delete;
+
+  std::size_t size() const { return header->count; }
+  const SnapshotRecord *records() const { return record_data; }
+  const SnapshotRecord &operator[](std::size_t i) const { return record_data[i]; }
+  std::string_view name(std::size_t i) const;
+
+  // Копирует все NPC в новые слоты мира подряд, не занимая кладбище;
+  // возвращает id первого. Неизвестный тип, координата вне
+  // [0, kMaxCoordinate] или имя за пределами строк - std::runtime_error
+  // до каких-либо изменений мира.
+  entity_id load_into(World &world) const;
+
+private:
+  void *data = nullptr;
+  std::size_t length = 0;
+  const SnapshotHeader *header = nullptr;
+  const SnapshotRecord *record_data = nullptr;
+  const char *strings = nullptr;
+};
+
+// Текстовый формат NPC::save как путь импорта и экспорта: по четыре строки
+// на NPC - тип, x, y, имя.
+void export_text(const World &world, std::ostream &os);
+
+// Импорт режет текст на части по границам строк, разбирает их
+// std::from_chars параллельно на пуле и рождает всех NPC одним
+// World::spawn_bulk в новых слотах. Ошибка разбора, координата вне
+// [0, kMaxCoordinate] или обрезанная запись - std::runtime_error с номером
+// строки, мир при этом не меняется.
+// Возвращает число NPC.
+std::size_t import_text(World &world, std::string_view text, ThreadPool *pool = nullptr);
+// Поток читается целиком и разбирается как буфер
+std::size_t import_text(World &world, std::istream &is, ThreadPool *pool = nullptr);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Маска типов NPC для фильтра запросов: бит t - NpcType t
+using TypeMask = std::uint8_t;
+constexpr TypeMask kAnyType = 0xFF;
+constexpr TypeMask type_bit(NpcType type) { return TypeMask(1u << type); }
+
+struct RadiusQuery {
+  int x;
+  int y;
+  int radius;
+  TypeMask types = kAnyType;
+};
+
+// Границы включительно
+struct BoxQuery {
+  int min_x;
+  int min_y;
+  int max_x;
+  int max_y;
+  TypeMask types = kAnyType;
+};
+
+struct NearestQuery {
+  int x;
+  int y;
+  std::size_t k;
+  TypeMask types = kAnyType;
+};
+
+// Ответы на пачку запросов подряд: ответ на запрос q - ids[offsets[q], offsets[q + 1])
+struct QueryResults {
+  std::vector<entity_id> ids;
+  std::vector<std::size_t> offsets;
+
+  std::size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+  const entity_id *begin(std::size_t q) const { return ids.data() + offsets[q]; }
+  const entity_id *end(std::size_t q) const { return ids.data() + offsets[q + 1]; }
+  std::size_t count(std::size_t q) const { return offsets[q + 1] - offsets[q]; }
+};
+
+// k-d дерево по живым NPC мира: запросы по радиусу, прямоугольнику,
+// k ближайших, с фильтром по типу. Узел хранит рамку и маску типов своего
+// поддерева, поэтому ветки без нужных типов отсекаются целиком.
+//
+// Дерево - снимок позиций на момент build/refit, мир оно не держит.
+// refit обновляет позиции и выбрасывает погибших без перестройки за O(n),
+// но рамки узлов со временем разбухают: раз в несколько тиков (и после
+// рождений) нужен build. Запросы только читают дерево и безопасны из
+// нескольких потоков.
+class SpatialIndex {
+public:
+  static constexpr std::size_t kLeafSize = 16;
+
+  void build(const World &world);
+  // false - в мире есть NPC, которых нет в дереве (родились), нужен build
+  bool refit(const World &world);
+
+  std::size_t size() const { return live; }
+
+  // Порядок id в ответе не определён
+  void within_radius(const RadiusQuery &query, std::vector<entity_id> &out) const;
+  void in_box(const BoxQuery &query, std::vector<entity_id> &out) const;
+  // До k ближайших по возрастанию расстояния, при равенстве - по id
+  void nearest(const NearestQuery &query, std::vector<entity_id> &out) const;
+
+  // Пачки: каждый ответ такой же, как у одиночного запроса. С пулом
+  // пачка делится на части по потокам.
+  void query(const std::vector<RadiusQuery> &queries, QueryResults &results, ThreadPool *pool = nullptr) const;
+  void query(const std::vector<BoxQuery> &queries, QueryResults &results, ThreadPool *pool = nullptr) const;
+  void query(const std::vector<NearestQuery> &queries, QueryResults &results, ThreadPool *pool = nullptr) const;
+
+private:
+  struct Point {
+    int x;
+    int y;
+    entity_id id;
+    TypeMask type; // 0 - погиб после build
+  };
+
+  // Узлы в прямом порядке: левый потомок идёт сразу за родителем
+  struct Node {
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+    std::uint32_t begin;
+    std::uint32_t end;
+    std::uint32_t right; // 0 - лист
+    TypeMask types;
+  };
+
+  std::vector<Point> points;
+  std::vector<Node> nodes;
+  std::size_t live = 0;
+
+  std::uint32_t build_node(std::uint32_t begin, std::uint32_t end);
+  void fit_node(Node &node) const;
+  template <class Query, class Fn>
+  void run_batch(const std::vector<Query> &queries, QueryResults &results, ThreadPool *pool, Fn &&fn) const;
+};
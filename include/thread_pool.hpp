@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с кражей задач. Вызывающий поток работает как воркер 0,
+// поэтому пул из одного потока выполняет всё последовательно.
+class ThreadPool {
+public:
+  using Job = std::function<void(std::size_t task, std::size_t worker)>;
+
+  explicit ThreadPool(std::size_t threads = default_threads());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  std::size_t size() const { return queues.size(); }
+
+  // Выполняет job для задач [0, tasks) и ждёт завершения всех
+  void parallel_for(std::size_t tasks, const Job &job);
+
+  static std::size_t default_threads();
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::size_t> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::size_t generation = 0;
+  bool stop = false;
+
+  const Job *job = nullptr;
+  std::atomic<std::size_t> remaining{0};
+
+  void worker_loop(std::size_t index);
+  void run_tasks(std::size_t index);
+  bool pop(std::size_t index, std::size_t &task);
+  bool steal(std::size_t index, std::size_t &task);
+};
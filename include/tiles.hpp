@@ -0,0 +1,59 @@
+#pragma once
+
+#include "grid.hpp"
+#include "world.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Разбиение карты на квадратные тайлы со своей сеткой соседей. NPC
+// принадлежит тайлу, в котором стоит; если до соседнего тайла не дальше halo,
+// его позиция копируется и в сетку соседа (гость). Пары для своих NPC тайл
+// ищет только в своей сетке, поэтому тайлы обрабатываются независимо.
+class TileMap {
+public:
+  // Сторона тайла по умолчанию: карта меньше неё остаётся одним тайлом
+  static constexpr int kDefaultTileSize = 16384;
+
+  // tile_size <= 0 - kDefaultTileSize; halo - наибольшая дистанция убийства
+  TileMap(int max_x, int max_y, int tile_size, int halo);
+
+  // Раскладывает живых NPC по тайлам (свои и гости) в порядке id.
+  // Сетки тайлов после этого надо перестроить через build.
+  void assign(const World &world);
+  // Перестраивает сетку одного тайла; разные тайлы можно строить параллельно
+  void build(std::size_t tile, const World &world);
+
+  std::size_t tile_count() const { return tiles.size(); }
+  int get_tile_size() const { return tile_size; }
+  int get_halo() const { return halo; }
+
+  const std::vector<entity_id> &owned(std::size_t tile) const { return tiles[tile].owned; }
+  const std::vector<entity_id> &guests(std::size_t tile) const { return tiles[tile].guests; }
+  // Всего гостей после последнего assign
+  std::size_t guest_count() const { return guest_total; }
+
+  // Соседи в радиусе distance среди своих и гостей тайла.
+  // Возвращает число проверенных пар.
+  template <class F>
+  std::size_t for_each_within(std::size_t tile, int x, int y, int distance, F &&fn) const {
+    return tiles[tile].grid.for_each_within(x, y, distance, fn);
+  }
+
+private:
+  struct Tile {
+    Tile(int cell_size, int max_x, int max_y, int min_x, int min_y, std::size_t max_cells)
+        : grid(cell_size, max_x, max_y, min_x, min_y, max_cells) {}
+
+    std::vector<entity_id> owned;
+    std::vector<entity_id> guests;
+    SpatialGrid grid;
+  };
+
+  int tile_size;
+  int halo;
+  int cols;
+  int rows;
+  std::size_t guest_total = 0;
+  std::vector<Tile> tiles;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Сборка без трассировки: -DDUNGEON_TRACE=0, макросы ниже исчезают целиком
+#ifndef DUNGEON_TRACE
+#define DUNGEON_TRACE 1
+#endif
+
+struct TraceEvent {
+  const char *name;
+  std::uint64_t ts_ns;
+  std::uint32_t attacker;
+  std::uint32_t defender;
+  char phase; // 'B', 'E', 'i'
+};
+
+// Трассировка в формате Chrome trace (chrome://tracing, ui.perfetto.dev).
+// Каждый поток пишет события в свой буфер без блокировок, буферы
+// выгружаются одним JSON при завершении. Включается явно через start;
+// до этого каждая точка трассировки - одна проверка флага.
+class Tracer {
+public:
+  static Tracer &global();
+
+  // events_per_thread - ёмкость буфера потока, лишние события отбрасываются
+  void start(std::size_t events_per_thread = 1 << 18);
+  void stop();
+  bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+  void set_thread_name(const char *name);
+  void begin(const char *name);
+  void end(const char *name);
+  void instant(const char *name, std::uint32_t attacker, std::uint32_t defender);
+
+  // Пишет всё, что потоки успели опубликовать; писать можно и на ходу
+  void write_chrome_json(std::ostream &os) const;
+
+  std::uint64_t recorded() const;
+  std::uint64_t dropped() const;
+
+private:
+  struct Buffer;
+
+  std::atomic<bool> active{false};
+  std::atomic<std::uint64_t> generation{0};
+  std::size_t capacity = 0;
+  std::chrono::steady_clock::time_point origin;
+
+  mutable std::mutex buffers_mutex;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+
+  Buffer *local_buffer();
+  void push(char phase, const char *name, std::uint32_t attacker, std::uint32_t defender);
+};
+
+class TraceScope {
+public:
+  explicit TraceScope(const char *_name) : name(Tracer::global().enabled() ? _name : nullptr) {
+    if (name)
+      Tracer::global().begin(name);
+  }
+  ~TraceScope() {
+    if (name)
+      Tracer::global().end(name);
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name;
+};
+
+#define DUNGEON_TRACE_CONCAT_(a, b) a##b
+#define DUNGEON_TRACE_CONCAT(a, b) DUNGEON_TRACE_CONCAT_(a, b)
+
+#if DUNGEON_TRACE
+#define TRACE_SCOPE(name) TraceScope DUNGEON_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_INSTANT(name, attacker, defender)                                                   \
+  do {                                                                                             \
+    if (Tracer::global().enabled())                                                                \
+      Tracer::global().instant(name, attacker, defender);                                          \
+  } while (0)
+#define TRACE_THREAD_NAME(name) Tracer::global().set_thread_name(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_INSTANT(name, attacker, defender) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "event_bus.hpp"
+#include "npc.hpp"
+#include "slab.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using entity_id = std::uint32_t;
+
+// Ссылка на сущность, переживающая переиспользование слота:
+// после смерти поколение слота растёт и старые ссылки становятся недействительны
+struct EntityRef {
+  entity_id id;
+  std::uint32_t generation;
+};
+
+// Имена: до 23 символов лежат прямо в массиве без выделения памяти,
+// длиннее - в отдельной таблице
+class NameTable {
+public:
+  void resize(std::size_t n) { slots.resize(n); }
+  void reserve(std::size_t n) { slots.reserve(n); }
+  void assign(entity_id id, std::string_view name);
+  // Короткое имя в слот без таблицы длинных: безопасно из разных потоков
+  // для разных новых слотов. false - имя длинное, нужен assign.
+  bool assign_inline(entity_id id, std::string_view name);
+  std::string_view get(entity_id id) const;
+
+private:
+  static constexpr std::uint8_t kLong = 0xFF;
+  struct Slot {
+    char chars[23];
+    std::uint8_t length;
+  };
+
+  std::vector<Slot> slots;
+  std::unordered_map<entity_id, std::string> long_names;
+};
+
+// Запись массового рождения, имя копируется в мир
+struct SpawnRecord {
+  NpcType type;
+  int x;
+  int y;
+  std::string_view name;
+};
+
+// Изменения мира между двумя World::collect_changes: каждый id - в одном
+// списке, списки по возрастанию id. Что с NPC теперь, смотрят в самом мире:
+// died - слот сейчас мёртв, born - слот занят заново (рождение или
+// возрождение), moved - живой NPC только сменил позицию. renamed - те из
+// died, в которых успел родиться и погибнуть новый NPC: имя слота в мире
+// уже не то, что было на прошлом сборе.
+struct WorldChanges {
+  std::vector<entity_id> died;
+  std::vector<entity_id> born;
+  std::vector<entity_id> moved;
+  std::vector<entity_id> renamed;
+
+  std::size_t size() const { return died.size() + born.size() + moved.size(); }
+};
+
+// Хранилище NPC в виде параллельных массивов (structure of arrays).
+// Индекс в массивах - entity_id, объекты NPC - лишь ручки над ним.
+// Слоты погибших NPC попадают на кладбище (список свободных) и
+// переиспользуются новыми NPC; id живого NPC не меняется до его смерти.
+//
+// Живые id собраны в плотный список active_ids(), чтобы тик обходил только
+// живых, а не все когда-либо созданные слоты. Смерть лишь помечает запись,
+// вычищает помеченные compact() - владелец тика зовёт её перед обходом.
+//
+// Поэлементных блокировок нет: тик идёт фазами (движение, поиск пар, бои),
+// и в каждой фазе массивы пишет только её владелец. Остальные потоки читают
+// кадр прошлого тика из FrameBuffer (frame.hpp).
+class World {
+public:
+  entity_id spawn(NpcType type, int x, int y, std::string_view name);
+  // Массовое рождение count NPC в новых слотах подряд, кладбище не
+  // занимается: i-я запись получает id first + i, возвращается first.
+  // fill(i, scratch) отдаёт i-ю запись; scratch - строка задачи, в которой
+  // можно собрать имя. С пулом записи раскладываются частями параллельно,
+  // fill зовётся из разных потоков.
+  template <class Fill> entity_id spawn_bulk(std::size_t count, ThreadPool *pool, Fill &&fill);
+  entity_id spawn_bulk(const std::vector<SpawnRecord> &records, ThreadPool *pool = nullptr);
+  void kill(entity_id id);
+  void revive(entity_id id);
+  // NPC ровно в слот id (восстановление из журнала): занятый слот
+  // переписывается, недостающие слоты до id встают на кладбище
+  void restore(entity_id id, NpcType type, int x, int y, std::string_view name);
+  void reserve(std::size_t n);
+  std::size_t size() const { return type.size(); }
+  // Ведётся в spawn/kill/revive, поэтому флаг alive напрямую не пишут
+  std::size_t alive_count() const { return living; }
+  std::size_t free_count() const { return free_ids.size(); }
+
+  // Живые id по возрастанию. Между compact() в списке остаются погибшие
+  // после прошлой чистки, а родившиеся в чужих слотах идут в конце.
+  const std::vector<entity_id> &active_ids() const { return active; }
+  // Чистит и упорядочивает список за O(его длины); без смертей и рождений - ничего
+  void compact();
+  // Слоты погибших, которые ещё не заняли: записи в массивах сохраняются
+  // для снимков и отчёта. Порядок не задан: revive переставляет слоты
+  const std::vector<entity_id> &graveyard() const { return free_ids; }
+
+  EntityRef ref(entity_id id) const { return {id, generation[id]}; }
+  bool is_valid(EntityRef ref) const {
+    return ref.id < size() && generation[ref.id] == ref.generation && alive[ref.id];
+  }
+
+  std::string_view name(entity_id id) const { return names.get(id); }
+
+  // Учёт изменений для журнала (journal.hpp). Пока он включён, move
+  // помечает сдвинутый слот, а рождения и смерти копятся списком.
+  // collect_changes отдаёт накопленное с прошлого вызова за O(active_ids)
+  // и сбрасывает пометки.
+  void track_changes(bool on);
+  bool tracking_changes() const { return tracking; }
+  void collect_changes(WorldChanges &out);
+
+  void move(entity_id id, int dx, int dy, int max_x, int max_y);
+  bool is_close(entity_id a, entity_id b, int distance) const;
+
+  // Дистанции по типу для новых NPC, по умолчанию npc_traits. set_traits
+  // переписывает и дистанции уже живущих NPC этого типа.
+  const NpcTraits &get_traits(NpcType t) const { return traits[t]; }
+  void set_traits(NpcType t, NpcTraits value);
+  // Наибольшая дистанция убийства среди типов и уже живущих NPC
+  int max_kill_distance() const;
+
+  // Блокировка для структурных операций: массовая загрузка и сохранение,
+  // чтение имён из потоков вне тика. Фазы тика её не берут.
+  std::shared_mutex &get_mutex() const { return mutex; }
+
+  // Пул для объектов-ручек NPC, создаётся при первом обращении
+  const std::shared_ptr<SlabPool> &handle_pool();
+
+  std::vector<int> x;
+  std::vector<int> y;
+  std::vector<NpcType> type;
+  std::vector<std::uint8_t> alive;
+  std::vector<int> move_distance;
+  std::vector<int> kill_distance;
+  std::vector<std::uint32_t> generation;
+  // NPC ведёт поведение (behavior.hpp), случайный шаг движения ему не делается
+  std::vector<std::uint8_t> scripted;
+
+  // Бои всех NPC мира, раздаются подписчикам пачкой раз за тик
+  EventBus events;
+
+private:
+  NameTable names;
+  TraitsTable traits = default_traits();
+  std::vector<entity_id> free_ids;
+  // Позиция слота в free_ids или kNotFree: revive снимает слот с кладбища
+  // за O(1), переставляя на его место последний
+  static constexpr std::uint32_t kNotFree = ~std::uint32_t(0);
+  std::vector<std::uint32_t> free_index;
+  std::vector<entity_id> active;
+  // Слот есть в active (возможно, уже мёртвым)
+  std::vector<std::uint8_t> listed;
+  bool active_dirty = false;
+  std::size_t living = 0;
+  // Пометки учёта изменений по слотам и слоты с рождениями и смертями
+  static constexpr std::uint8_t kTouchMoved = 1;
+  static constexpr std::uint8_t kTouchLife = 2;
+  // В слот лёг новый NPC со своим именем
+  static constexpr std::uint8_t kTouchBirth = 4;
+  bool tracking = false;
+  std::vector<std::uint8_t> touched;
+  std::vector<entity_id> life_changed;
+  std::shared_ptr<SlabPool> pool;
+  mutable std::shared_mutex mutex;
+
+  // Записей на задачу пула в spawn_bulk
+  static constexpr std::size_t kBulkChunk = 16384;
+  using LongNames = std::vector<std::pair<entity_id, std::string>>;
+
+  void list_active(entity_id id);
+  // Кладёт слот в конец free_ids и запоминает его позицию
+  void bury(entity_id id);
+  void touch_life(entity_id id);
+  void touch_birth(entity_id id);
+  entity_id grow(std::size_t count);
+  void place(entity_id id, const SpawnRecord &record, LongNames &long_names);
+  void finish_bulk(entity_id first, std::size_t count, std::vector<LongNames> &long_names);
+};
+
+template <class Fill> entity_id World::spawn_bulk(std::size_t count, ThreadPool *pool, Fill &&fill) {
+  entity_id first = grow(count);
+  std::size_t chunks = (count + kBulkChunk - 1) / kBulkChunk;
+  // Длинные имена идут в общую таблицу, её заполняем после раскладки
+  std::vector<LongNames> long_names(chunks);
+  auto place_chunk = [&](std::size_t chunk, std::size_t) {
+    std::string scratch;
+    std::size_t end = std::min(count, (chunk + 1) * kBulkChunk);
+    for (std::size_t i = chunk * kBulkChunk; i < end; ++i)
+      place(first + entity_id(i), fill(i, scratch), long_names[chunk]);
+  };
+  if (pool && chunks > 1) {
+    pool->parallel_for(chunks, place_chunk);
+  } else {
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk)
+      place_chunk(chunk, 0);
+  }
+  finish_bulk(first, count, long_names);
+  return first;
+}
@@ -0,0 +1,338 @@
+#include "../include/behavior.hpp"
+#include "../include/movement.hpp"
+#include "../include/rules.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Кадры сопрограмм по классам размера с шагом kFrameStep; больше kMaxPooledFrame - в кучу
+constexpr std::size_t kFrameStep = 16;
+constexpr std::size_t kMaxPooledFrame = 1024;
+
+struct FramePools {
+  std::vector<std::unique_ptr<SlabPool>> pools;
+
+  FramePools() {
+    for (std::size_t size = kFrameStep; size <= kMaxPooledFrame; size += kFrameStep)
+      pools.push_back(std::make_unique<SlabPool>(size));
+  }
+
+  SlabPool *find(std::size_t size) {
+    return size <= kMaxPooledFrame ? pools[(size + kFrameStep - 1) / kFrameStep - 1].get() : nullptr;
+  }
+};
+
+FramePools &frame_pools() {
+  static FramePools pools;
+  return pools;
+}
+
+int step_toward(int from, int to, int distance) { return std::clamp(to - from, -distance, distance); }
+
+int sign(int value) { return (value > 0) - (value < 0); }
+
+} // namespace
+
+void *Behavior::promise_type::operator new(std::size_t size) {
+  if (SlabPool *pool = frame_pools().find(size))
+    return pool->allocate();
+  return ::operator new(size);
+}
+
+void Behavior::promise_type::operator delete(void *frame, std::size_t size) {
+  if (SlabPool *pool = frame_pools().find(size))
+    pool->deallocate(frame);
+  else
+    ::operator delete(frame);
+}
+
+std::size_t behavior_frame_bytes() {
+  std::size_t bytes = 0;
+  for (const auto &pool : frame_pools().pools)
+    bytes += pool->in_use() * pool->get_block_size();
+  return bytes;
+}
+
+void Agent::TickAwaiter::await_suspend(std::coroutine_handle<>) const { scheduler->wait_ticks(id, ticks); }
+
+void Agent::SenseAwaiter::await_suspend(std::coroutine_handle<>) const {
+  scheduler->wait_sense(id, what, radius, timeout);
+}
+
+entity_id Agent::SenseAwaiter::await_resume() const { return scheduler->found[id]; }
+
+World &Agent::world() const { return scheduler->world; }
+
+std::uint64_t Agent::tick() const { return scheduler->now; }
+
+bool Agent::near(entity_id other, int distance) const {
+  return other != kNoEntity && world().alive[other] && world().is_close(self, other, distance);
+}
+
+void Agent::step_towards(entity_id other) {
+  World &w = world();
+  int distance = w.move_distance[self];
+  w.move(self, step_toward(w.x[self], w.x[other], distance), step_toward(w.y[self], w.y[other], distance),
+         scheduler->max_x, scheduler->max_y);
+}
+
+void Agent::step_away(entity_id other) {
+  World &w = world();
+  int dx = sign(w.x[self] - w.x[other]);
+  int dy = sign(w.y[self] - w.y[other]);
+  // В одной точке бежать некуда по направлению - бежим наугад
+  if (!dx && !dy)
+    move_direction(move_stream(scheduler->seed, scheduler->now), self, dx, dy);
+  step(dx, dy);
+}
+
+void Agent::step(int dx, int dy) {
+  World &w = world();
+  w.move(self, dx * w.move_distance[self], dy * w.move_distance[self], scheduler->max_x, scheduler->max_y);
+}
+
+void Agent::wander() {
+  int dx, dy;
+  move_direction(move_stream(scheduler->seed, scheduler->now), self, dx, dy);
+  step(dx, dy);
+}
+
+BehaviorScheduler::BehaviorScheduler(World &_world, int _max_x, int _max_y, std::uint64_t _seed,
+                                     ThreadPool *_pool, int _sense_radius)
+    : world(_world), max_x(_max_x), max_y(_max_y), seed(_seed), sense_radius(std::max(1, _sense_radius)),
+      pool(_pool), wheel(kWheelSize), grid(sense_radius, _max_x, _max_y) {}
+
+BehaviorScheduler::~BehaviorScheduler() {
+  for (auto handle : handles) {
+    if (handle)
+      handle.destroy();
+  }
+}
+
+void BehaviorScheduler::attach(entity_id id, Behavior behavior) {
+  if (id >= handles.size()) {
+    std::size_t n = std::max<std::size_t>(world.size(), std::size_t(id) + 1);
+    handles.resize(n);
+    owner.resize(n, 0);
+    wake_at.resize(n, kForever);
+    sense_what.resize(n, 0);
+    sense_range.resize(n, 0);
+    watch_listed.resize(n, 0);
+    found.resize(n, kNoEntity);
+  }
+  if (handles[id])
+    finish(id);
+
+  handles[id] = behavior.release();
+  owner[id] = world.generation[id];
+  world.scripted[id] = 1;
+  starting.push_back(id);
+  ++attached_count;
+}
+
+void BehaviorScheduler::detach(entity_id id) {
+  if (id < handles.size() && handles[id])
+    finish(id);
+}
+
+void BehaviorScheduler::finish(entity_id id) {
+  handles[id].destroy();
+  handles[id] = {};
+  wake_at[id] = kForever;
+  sense_what[id] = 0;
+  --attached_count;
+  // Закончивший поведение NPC снова ходит случайно
+  if (world.generation[id] == owner[id])
+    world.scripted[id] = 0;
+}
+
+void BehaviorScheduler::schedule(entity_id id, std::uint64_t tick) {
+  wake_at[id] = tick;
+  if (tick != kForever)
+    wheel[tick % kWheelSize].push_back(id);
+}
+
+void BehaviorScheduler::wait_ticks(entity_id id, std::uint64_t ticks) {
+  schedule(id, ticks >= kForever - now ? kForever : now + std::max<std::uint64_t>(1, ticks));
+}
+
+void BehaviorScheduler::wait_sense(entity_id id, std::uint8_t what, int radius, std::uint64_t timeout) {
+  sense_what[id] = what;
+  sense_range[id] = std::clamp(radius, 0, sense_radius);
+  found[id] = kNoEntity;
+  if (!watch_listed[id]) {
+    watch_listed[id] = 1;
+    watchers.push_back(id);
+  }
+  wait_ticks(id, timeout);
+}
+
+void BehaviorScheduler::sense_watchers() {
+  grid.clear();
+  for (entity_id id : world.active_ids()) {
+    if (world.alive[id])
+      grid.insert(id, world.x[id], world.y[id]);
+  }
+
+  // Только чтение мира: каждый наблюдатель пишет лишь свой found
+  auto probe = [&](std::size_t from, std::size_t to) {
+    for (std::size_t k = from; k < to; ++k) {
+      entity_id id = watchers[k];
+      found[id] = kNoEntity;
+      if (!world.alive[id] || !sense_what[id]) continue;
+
+      NpcType own = world.type[id];
+      std::uint8_t what = sense_what[id];
+      std::int64_t best = -1;
+      grid.for_each_within(world.x[id], world.y[id], sense_range[id], [&](std::size_t other) {
+        if (other == id) return;
+        NpcType type = world.type[other];
+        bool match = ((what & SensePrey) && can_kill(own, type)) || ((what & SenseThreat) && can_kill(type, own));
+        if (!match) return;
+
+        std::int64_t dx = std::int64_t(world.x[other]) - world.x[id];
+        std::int64_t dy = std::int64_t(world.y[other]) - world.y[id];
+        std::int64_t distance = dx * dx + dy * dy;
+        if (best < 0 || distance < best || (distance == best && other < found[id])) {
+          best = distance;
+          found[id] = entity_id(other);
+        }
+      });
+    }
+  };
+
+  const std::size_t chunk = 1024;
+  if (pool && watchers.size() > chunk) {
+    pool->parallel_for((watchers.size() + chunk - 1) / chunk, [&](std::size_t task, std::size_t) {
+      probe(task * chunk, std::min(watchers.size(), (task + 1) * chunk));
+    });
+  } else {
+    probe(0, watchers.size());
+  }
+
+  for (entity_id id : watchers) {
+    if (found[id] != kNoEntity)
+      due.push_back(id);
+  }
+}
+
+std::size_t BehaviorScheduler::run(std::uint64_t tick) {
+  Metrics::Scope scope(metrics, Timer::Behave);
+  TRACE_SCOPE("behave");
+  now = tick;
+  due.clear();
+  due.insert(due.end(), starting.begin(), starting.end());
+  starting.clear();
+
+  // Колесо: запись с тем же остатком, но дальним сроком остаётся в ячейке
+  auto &slot = wheel[tick % kWheelSize];
+  std::size_t kept = 0;
+  for (entity_id id : slot) {
+    if (wake_at[id] == tick)
+      due.push_back(id);
+    else if (wake_at[id] > tick && wake_at[id] != kForever && wake_at[id] % kWheelSize == tick % kWheelSize)
+      slot[kept++] = id;
+  }
+  slot.resize(kept);
+
+  if (!watchers.empty())
+    sense_watchers();
+
+  std::sort(due.begin(), due.end());
+  due.erase(std::unique(due.begin(), due.end()), due.end());
+
+  std::size_t resumed = 0;
+  for (entity_id id : due) {
+    if (!handles[id]) continue;
+    if (!world.alive[id] || world.generation[id] != owner[id]) {
+      finish(id);
+      continue;
+    }
+
+    wake_at[id] = kForever;
+    sense_what[id] = 0;
+    handles[id].resume();
+    ++resumed;
+    if (handles[id].done())
+      finish(id);
+  }
+
+  // Наблюдатели, которые больше не ждут датчика или погибли, выбывают
+  std::size_t watching = 0;
+  for (entity_id id : watchers) {
+    if (handles[id] && (!world.alive[id] || world.generation[id] != owner[id]))
+      finish(id);
+    if (handles[id] && sense_what[id])
+      watchers[watching++] = id;
+    else
+      watch_listed[id] = 0;
+  }
+  watchers.resize(watching);
+  return resumed;
+}
+
+Behavior hunt(Agent self) {
+  const int range = BehaviorScheduler::kDefaultSenseRadius;
+  for (;;) {
+    entity_id prey = co_await self.sense(SensePrey, range, 8);
+    if (prey == kNoEntity) {
+      // Никого рядом - перелетаем на новое место
+      self.wander();
+      continue;
+    }
+    while (self.near(prey, range)) {
+      self.step_towards(prey);
+      co_await self.next_tick();
+    }
+  }
+}
+
+Behavior flee(Agent self) {
+  const int range = BehaviorScheduler::kDefaultSenseRadius / 2;
+  for (;;) {
+    // Пасётся на месте, пока угроза не подойдёт
+    entity_id threat = co_await self.sense(SenseThreat, range);
+    while (self.near(threat, range)) {
+      self.step_away(threat);
+      co_await self.next_tick();
+    }
+  }
+}
+
+Behavior patrol(Agent self, int span) {
+  const int range = BehaviorScheduler::kDefaultSenseRadius / 2;
+  const int home_x = self.x();
+  int direction = 1;
+  for (;;) {
+    entity_id dragon = co_await self.sense(SensePrey, range, 1);
+    if (dragon != kNoEntity) {
+      self.step_towards(dragon);
+      continue;
+    }
+    // Ходит вдоль x между home_x и home_x + span, у края карты разворачивается
+    int before = self.x();
+    self.step(direction, 0);
+    int target = direction > 0 ? home_x + span : home_x;
+    if (self.x() == before || (target - self.x()) * direction <= 0)
+      direction = -direction;
+  }
+}
+
+Behavior default_behavior(Agent self, NpcType type) {
+  switch (type) {
+  case DragonType:
+    return hunt(self);
+  case PegasusType:
+    return flee(self);
+  default:
+    return patrol(self, 4 * BehaviorScheduler::kDefaultSenseRadius);
+  }
+}
+
+void attach_default_behaviors(BehaviorScheduler &scheduler, World &world) {
+  world.compact();
+  for (entity_id id : world.active_ids())
+    scheduler.attach(id, default_behavior(Agent(scheduler, id), world.type[id]));
+}
@@ -0,0 +1,187 @@
+#include "../include/combat.hpp"
+#include "../include/rules.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Номер потока случайных чисел для боёв
+constexpr std::uint64_t kFightStream = ~std::uint64_t(0) - 1;
+
+bool pair_less(const FightPair &x, const FightPair &y) { return x.a != y.a ? x.a < y.a : x.b < y.b; }
+
+} // namespace
+
+std::uint64_t fight_stream(std::uint64_t seed, std::uint64_t tick) {
+  return stream_seed(seed, tick, kFightStream);
+}
+
+Encounter roll_encounter(std::uint64_t stream, const FightPair &pair) {
+  std::uint64_t bits = stream_seed(stream, pair.a, pair.b);
+  int roll_a = int((bits & 0xFFFFFFFFu) % 6);
+  int roll_b = int((bits >> 32) % 6);
+  if (roll_a > roll_b && (pair.reach & FightPair::kReachAB))
+    return {pair.a, pair.b, true};
+  if (roll_b > roll_a && (pair.reach & FightPair::kReachBA))
+    return {pair.b, pair.a, true};
+  return {pair.a, pair.b, false};
+}
+
+void CombatBatch::build(const std::vector<FightCandidate> &candidates) {
+  // Прямые пары (i < j) уже идут по порядку, обратные досортировываются
+  // и вливаются в прямые со слиянием одинаковых
+  std::vector<FightPair> &forward = pairs;
+  forward.clear();
+  std::vector<FightPair> backward;
+  for (const auto &candidate : candidates) {
+    if (candidate.attacker < candidate.defender)
+      forward.push_back({candidate.attacker, candidate.defender, FightPair::kReachAB});
+    else
+      backward.push_back({candidate.defender, candidate.attacker, FightPair::kReachBA});
+  }
+  std::sort(backward.begin(), backward.end(), pair_less);
+
+  std::size_t middle = forward.size();
+  forward.insert(forward.end(), backward.begin(), backward.end());
+  std::inplace_merge(forward.begin(), forward.begin() + middle, forward.end(), pair_less);
+  std::size_t unique = 0;
+  for (std::size_t k = 0; k < forward.size(); ++k) {
+    if (unique > 0 && forward[unique - 1].a == forward[k].a && forward[unique - 1].b == forward[k].b)
+      forward[unique - 1].reach |= forward[k].reach;
+    else
+      forward[unique++] = forward[k];
+  }
+  forward.resize(unique);
+
+  // Жадная раскраска рёбер: пара встаёт в первый раунд, свободный у обоих
+  // участников, раундов выходит меньше 2 * (наибольшее число пар у NPC).
+  // Занятые раунды хранятся столбцами по 64 раунда, строка на участника
+  // больше чем с одной парой: единственную пару ставить больше не с чем.
+  // Столбец добавляется, когда раунды до него заняты, так что память -
+  // строки на фактическое число раундов, а не на наибольшую степень.
+  constexpr std::uint32_t kNoRow = ~std::uint32_t(0);
+  std::vector<std::uint32_t> row;
+  for (const auto &pair : pairs) {
+    if (pair.b >= slot.size())
+      slot.resize(std::size_t(pair.b) + 1, 0);
+    for (entity_id id : {pair.a, pair.b}) {
+      if (slot[id] == 0) {
+        row.push_back(0);
+        slot[id] = std::uint32_t(row.size());
+      }
+      ++row[slot[id] - 1];
+    }
+  }
+  std::size_t rows = 0;
+  for (std::uint32_t &r : row)
+    r = r > 1 ? std::uint32_t(rows++) : kNoRow;
+  std::size_t words = 0;
+  used.clear();
+
+  std::uint32_t rounds = 0;
+  pair_round.resize(pairs.size());
+  for (std::size_t p = 0; p < pairs.size(); ++p) {
+    std::uint32_t row_a = row[slot[pairs[p].a] - 1];
+    std::uint32_t row_b = row[slot[pairs[p].b] - 1];
+    auto word = [&](std::uint32_t r, std::size_t w) -> std::uint64_t {
+      return r == kNoRow || w >= words ? 0 : used[w * rows + r];
+    };
+    // Слово words ещё не заведено и пусто, дальше него поиск не идёт
+    std::size_t w = 0;
+    while ((word(row_a, w) | word(row_b, w)) == ~std::uint64_t(0))
+      ++w;
+    int bit = __builtin_ctzll(~(word(row_a, w) | word(row_b, w)));
+    if (w == words && (row_a != kNoRow || row_b != kNoRow)) {
+      used.resize(used.size() + rows, 0);
+      ++words;
+    }
+    for (std::uint32_t r : {row_a, row_b}) {
+      if (r != kNoRow)
+        used[w * rows + r] |= std::uint64_t(1) << bit;
+    }
+    pair_round[p] = std::uint32_t(w * 64 + bit);
+    rounds = std::max(rounds, pair_round[p] + 1);
+  }
+  for (const auto &pair : pairs)
+    slot[pair.a] = slot[pair.b] = 0;
+
+  round_begin.assign(std::size_t(rounds) + 1, 0);
+  for (std::uint32_t round : pair_round)
+    ++round_begin[round + 1];
+  for (std::size_t r = 1; r < round_begin.size(); ++r)
+    round_begin[r] += round_begin[r - 1];
+  ordered.resize(pairs.size());
+  std::vector<std::size_t> fill(round_begin.begin(), round_begin.end() - 1);
+  for (std::size_t p = 0; p < pairs.size(); ++p)
+    ordered[fill[pair_round[p]]++] = std::uint32_t(p);
+}
+
+std::size_t CombatBatch::resolve(World &world, std::vector<std::shared_ptr<NPC>> &npcs, std::uint64_t seed,
+                                 std::uint64_t tick, ThreadPool *pool, Metrics *metrics,
+                                 std::vector<entity_id> *killed) {
+  Metrics::Scope scope(metrics, Timer::Fight);
+  TRACE_SCOPE("fight");
+  std::uint64_t stream = fight_stream(seed, tick);
+  std::size_t kills = 0;
+  std::size_t resolved = 0;
+
+  for (std::size_t r = 0; r + 1 < round_begin.size(); ++r) {
+    std::size_t begin = round_begin[r];
+    std::size_t end = round_begin[r + 1];
+
+    // Раунд судится параллельно: участники разных пар не пересекаются,
+    // жизнь меняется только при слиянии, поэтому мир только читается.
+    // Каждая задача пишет свои бои в свой буфер, в порядке пар.
+    auto judge = [&](std::size_t from, std::size_t to, std::vector<Fought> &out) {
+      out.clear();
+      for (std::size_t k = from; k < to; ++k) {
+        std::uint32_t p = ordered[k];
+        const FightPair &pair = pairs[p];
+        if (!world.alive[pair.a] || !world.alive[pair.b])
+          continue;
+        Encounter encounter = roll_encounter(stream, pair);
+        bool win = encounter.fought && can_kill(world.type[encounter.attacker], world.type[encounter.defender]);
+        out.push_back({encounter, win});
+      }
+    };
+    const std::size_t chunk = 1024;
+    std::size_t tasks = pool && end - begin >= kParallelRound ? (end - begin + chunk - 1) / chunk : 1;
+    if (task_fights.size() < tasks)
+      task_fights.resize(tasks);
+    if (tasks > 1) {
+      pool->parallel_for(tasks, [&](std::size_t task, std::size_t) {
+        judge(begin + task * chunk, std::min(end, begin + (task + 1) * chunk), task_fights[task]);
+      });
+    } else {
+      judge(begin, end, task_fights[0]);
+    }
+
+    // Слияние буферов по порядку задач - это порядок пар (a, b): уведомления
+    // и гибель идут в вызывающем потоке, как и в последовательном проходе
+    for (std::size_t task = 0; task < tasks; ++task) {
+      for (const Fought &fight : task_fights[task]) {
+        const Encounter &encounter = fight.encounter;
+        ++resolved;
+        TRACE_INSTANT("fight", std::min(encounter.attacker, encounter.defender),
+                      std::max(encounter.attacker, encounter.defender));
+        if (!encounter.fought)
+          continue;
+        npcs[encounter.attacker]->fight_notify(npcs[encounter.defender], fight.win);
+        if (!fight.win)
+          continue;
+        world.kill(encounter.defender);
+        ++kills;
+        if (killed)
+          killed->push_back(encounter.defender);
+        TRACE_INSTANT("kill", encounter.attacker, encounter.defender);
+      }
+    }
+  }
+
+  if (metrics) {
+    metrics->add(Counter::FightsResolved, resolved);
+    metrics->add(Counter::Kills, kills);
+  }
+  return kills;
+}
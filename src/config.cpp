@@ -0,0 +1,120 @@
+#include "../include/config.hpp"
+#include "../include/distance.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+constexpr std::string_view kTypeNames[] = {"", "knight", "dragon", "pegasus"};
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+    text.remove_prefix(1);
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+    text.remove_suffix(1);
+  return text;
+}
+
+// Читает очередное целое из text, сдвигая его за прочитанное
+template <class T> bool next_number(std::string_view &text, T &value) {
+  text = trim(text);
+  auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (result.ec != std::errc() || result.ptr == text.data())
+    return false;
+  text.remove_prefix(result.ptr - text.data());
+  return true;
+}
+
+// Значение целиком - одно число (или два для map), без хвоста
+template <class T> bool parse_value(std::string_view text, T &value) {
+  return next_number(text, value) && trim(text).empty();
+}
+
+bool parse_pair(std::string_view text, int &first, int &second) {
+  return next_number(text, first) && next_number(text, second) && trim(text).empty();
+}
+
+bool parse_traits(std::string_view key, std::string_view value, SimulationConfig &config) {
+  std::size_t dot = key.find('.');
+  if (dot == std::string_view::npos)
+    return false;
+  std::string_view type_name = key.substr(0, dot);
+  std::string_view field = key.substr(dot + 1);
+  for (std::size_t t = 1; t < std::size(kTypeNames); ++t) {
+    if (type_name != kTypeNames[t])
+      continue;
+    if (field == "move")
+      return parse_value(value, config.traits[t].move_distance);
+    if (field == "kill")
+      return parse_value(value, config.traits[t].kill_distance);
+    return false;
+  }
+  return false;
+}
+
+bool apply(std::string_view key, std::string_view value, SimulationConfig &config) {
+  if (key == "seed")
+    return parse_value(value, config.seed);
+  if (key == "npcs")
+    return parse_value(value, config.npc_count);
+  if (key == "map")
+    return parse_pair(value, config.max_x, config.max_y);
+  if (key == "ticks")
+    return parse_value(value, config.ticks);
+  if (key == "threads")
+    return parse_value(value, config.threads);
+  if (key == "tile")
+    return parse_value(value, config.tile_size);
+  if (key == "behaviors") {
+    int flag = 0;
+    if (!parse_value(value, flag) || (flag != 0 && flag != 1))
+      return false;
+    config.behaviors = flag;
+    return true;
+  }
+  return parse_traits(key, value, config);
+}
+
+void check_range(const char *what, long long value) {
+  if (value < 0 || value > kMaxCoordinate)
+    throw std::runtime_error(std::string(what) + " must be in [0, " + std::to_string(kMaxCoordinate) +
+                             "], got " + std::to_string(value));
+}
+
+} // namespace
+
+void load_config(std::istream &is, SimulationConfig &config) {
+  std::string line;
+  for (int number = 1; std::getline(is, line); ++number) {
+    std::string_view text = line;
+    text = trim(text.substr(0, text.find('#')));
+    if (text.empty())
+      continue;
+
+    std::size_t eq = text.find('=');
+    std::string_view key = trim(text.substr(0, eq));
+    if (eq == std::string_view::npos || !apply(key, text.substr(eq + 1), config))
+      throw std::runtime_error("config line " + std::to_string(number) + ": cannot parse '" + line + "'");
+  }
+}
+
+void load_config_file(const std::string &path, SimulationConfig &config) {
+  std::ifstream is(path);
+  if (!is)
+    throw std::runtime_error("cannot open config: " + path);
+  load_config(is, config);
+}
+
+void validate_config(const SimulationConfig &config) {
+  check_range("map width", config.max_x);
+  check_range("map height", config.max_y);
+  check_range("tile size", config.tile_size);
+  for (std::size_t t = 1; t < config.traits.size(); ++t) {
+    check_range("move distance", config.traits[t].move_distance);
+    check_range("kill distance", config.traits[t].kill_distance);
+  }
+}
@@ -0,0 +1,133 @@
+#include "../include/distance.hpp"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DUNGEON_X86 1
+#endif
+
+namespace {
+
+std::uint64_t mask_scalar(int ax, int ay, const int *xs, const int *ys,
+                          std::size_t n, std::int64_t r2) {
+  std::uint64_t mask = 0;
+  for (std::size_t k = 0; k < n; ++k) {
+    std::int64_t dx = xs[k] - ax;
+    std::int64_t dy = ys[k] - ay;
+    if (dx * dx + dy * dy <= r2)
+      mask |= std::uint64_t(1) << k;
+  }
+  return mask;
+}
+
+#ifdef DUNGEON_X86
+__attribute__((target("sse2"))) std::uint64_t
+mask_sse2(int ax, int ay, const int *xs, const int *ys, std::size_t n,
+          std::int64_t r2) {
+  const __m128i vax = _mm_set1_epi32(ax);
+  const __m128i vay = _mm_set1_epi32(ay);
+  const __m128d vr2 = _mm_set1_pd(double(r2));
+  std::uint64_t mask = 0;
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    __m128i dx = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(xs + k)), vax);
+    __m128i dy = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(ys + k)), vay);
+    __m128d dx_lo = _mm_cvtepi32_pd(dx);
+    __m128d dy_lo = _mm_cvtepi32_pd(dy);
+    __m128d dx_hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(dx, _MM_SHUFFLE(1, 0, 3, 2)));
+    __m128d dy_hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(dy, _MM_SHUFFLE(1, 0, 3, 2)));
+    __m128d lo = _mm_add_pd(_mm_mul_pd(dx_lo, dx_lo), _mm_mul_pd(dy_lo, dy_lo));
+    __m128d hi = _mm_add_pd(_mm_mul_pd(dx_hi, dx_hi), _mm_mul_pd(dy_hi, dy_hi));
+    unsigned bits = _mm_movemask_pd(_mm_cmple_pd(lo, vr2)) |
+                    (_mm_movemask_pd(_mm_cmple_pd(hi, vr2)) << 2);
+    mask |= std::uint64_t(bits) << k;
+  }
+  if (k < n)
+    mask |= mask_scalar(ax, ay, xs + k, ys + k, n - k, r2) << k;
+  return mask;
+}
+
+__attribute__((target("avx2"))) std::uint64_t
+mask_avx2(int ax, int ay, const int *xs, const int *ys, std::size_t n,
+          std::int64_t r2) {
+  const __m256i vax = _mm256_set1_epi32(ax);
+  const __m256i vay = _mm256_set1_epi32(ay);
+  const __m256i vr2 = _mm256_set1_epi64x(r2);
+  std::uint64_t mask = 0;
+  std::size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256i dx = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(xs + k)), vax);
+    __m256i dy = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(ys + k)), vay);
+    __m256i dx_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(dx));
+    __m256i dy_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(dy));
+    __m256i dx_hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(dx, 1));
+    __m256i dy_hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(dy, 1));
+    __m256i lo = _mm256_add_epi64(_mm256_mul_epi32(dx_lo, dx_lo), _mm256_mul_epi32(dy_lo, dy_lo));
+    __m256i hi = _mm256_add_epi64(_mm256_mul_epi32(dx_hi, dx_hi), _mm256_mul_epi32(dy_hi, dy_hi));
+    unsigned far = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(lo, vr2))) |
+                   (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(hi, vr2))) << 4);
+    mask |= std::uint64_t(~far & 0xFFu) << k;
+  }
+  if (k < n)
+    mask |= mask_scalar(ax, ay, xs + k, ys + k, n - k, r2) << k;
+  return mask;
+}
+#endif
+
+SimdLevel detect() {
+#ifdef DUNGEON_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SimdLevel::AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SimdLevel::SSE2;
+#endif
+  return SimdLevel::Scalar;
+}
+
+std::atomic<SimdLevel> current_level{detected_simd_level()};
+
+} // namespace
+
+SimdLevel detected_simd_level() {
+  static const SimdLevel level = detect();
+  return level;
+}
+
+SimdLevel get_simd_level() { return current_level.load(std::memory_order_relaxed); }
+
+void set_simd_level(SimdLevel level) {
+  if (level > detected_simd_level())
+    level = detected_simd_level();
+  current_level.store(level, std::memory_order_relaxed);
+}
+
+std::uint64_t within_distance_mask(int ax, int ay, const int *xs, const int *ys,
+                                   std::size_t n, int distance) {
+  std::int64_t r2 = std::int64_t(distance) * distance;
+  switch (get_simd_level()) {
+#ifdef DUNGEON_X86
+  case SimdLevel::AVX2:
+    return mask_avx2(ax, ay, xs, ys, n, r2);
+  case SimdLevel::SSE2:
+    return mask_sse2(ax, ay, xs, ys, n, r2);
+#endif
+  default:
+    return mask_scalar(ax, ay, xs, ys, n, r2);
+  }
+}
+
+std::size_t within_distance(int ax, int ay, const int *xs, const int *ys,
+                            std::size_t n, int distance, std::uint32_t *out) {
+  std::size_t found = 0;
+  for (std::size_t base = 0; base < n; base += 64) {
+    std::size_t block = n - base < 64 ? n - base : 64;
+    std::uint64_t mask = within_distance_mask(ax, ay, xs + base, ys + base, block, distance);
+    while (mask) {
+      out[found++] = std::uint32_t(base + __builtin_ctzll(mask));
+      mask &= mask - 1;
+    }
+  }
+  return found;
+}
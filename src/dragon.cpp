@@ -1,6 +1,7 @@
 #include "../include/dragon.hpp"
 #include "../include/knight.hpp"
 #include "../include/pegasus.hpp"
+#include "../include/rules.hpp"
 
 Dragon::Dragon(int x, int y, const std::string& name) 
     : NPC(DragonType, x, y, name) {}
@@ -8,6 +9,9 @@ Dragon::Dragon(int x, int y, const std::string& name)
 Dragon::Dragon(std::istream& is) 
     : NPC(DragonType, is) {}
 
+Dragon::Dragon(World& world, std::uint32_t id)
+    : NPC(world, id) {}
+
 void Dragon::print()
 {
     std::cout << *this;
@@ -15,7 +19,7 @@ void Dragon::print()
 
 void Dragon::save(std::ostream& os)
 {
-    os << DragonType << std::endl;
+    os << DragonType << '\n';
     NPC::save(os);
 }
 
@@ -29,20 +33,23 @@ bool Dragon::accept(std::shared_ptr<NPC> attacker)
 
 bool Dragon::visit(Knight& other)
 {
-    fight_notify(other.shared_from_this(), false);
-    return false;
+    bool win = can_kill(DragonType, KnightType);
+    fight_notify(other.shared_from_this(), win);
+    return win;
 }
 
 bool Dragon::visit(Dragon& other)
 {
-    fight_notify(other.shared_from_this(), false);
-    return false;
+    bool win = can_kill(DragonType, DragonType);
+    fight_notify(other.shared_from_this(), win);
+    return win;
 }
 
 bool Dragon::visit(Pegasus& other)
 {
-    fight_notify(other.shared_from_this(), true);
-    return true;
+    bool win = can_kill(DragonType, PegasusType);
+    fight_notify(other.shared_from_this(), win);
+    return win;
 }
 
 std::ostream& operator<<(std::ostream& os, Dragon& dragon)
@@ -0,0 +1,74 @@
+#include "../include/event_bus.hpp"
+
+#include <algorithm>
+
+EventFilter EventFilter::only(FightKind kind) {
+  EventFilter filter;
+  filter.kinds = std::uint8_t(kind);
+  return filter;
+}
+
+bool EventFilter::accepts_all() const {
+  return kinds == (std::uint8_t(FightKind::Kill) | std::uint8_t(FightKind::Fight)) &&
+         attacker_types == kAnyType && defender_types == kAnyType;
+}
+
+EventBus::SubscriptionId EventBus::subscribe(std::shared_ptr<IEventObserver> observer,
+                                             EventFilter filter) {
+  std::lock_guard lock(subscribers_mutex);
+  subscribers.push_back({next_id, std::move(observer), filter});
+  subscriber_count.store(subscribers.size(), std::memory_order_relaxed);
+  return next_id++;
+}
+
+void EventBus::unsubscribe(SubscriptionId id) {
+  std::lock_guard lock(subscribers_mutex);
+  subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                   [&](const Subscription &s) { return s.id == id; }),
+                    subscribers.end());
+  subscriber_count.store(subscribers.size(), std::memory_order_relaxed);
+}
+
+void EventBus::post(std::uint32_t attacker, std::uint32_t defender, NpcType attacker_type,
+                    NpcType defender_type, bool win) {
+  // Без подписчиков события некому отдавать - не копим их
+  if (!has_subscribers())
+    return;
+
+  FightOutcome event{current_tick.load(std::memory_order_relaxed), attacker, defender,
+                     attacker_type, defender_type, win ? FightKind::Kill : FightKind::Fight};
+  std::lock_guard lock(pending_mutex);
+  queued.push_back(event);
+}
+
+std::size_t EventBus::dispatch() {
+  delivering.clear();
+  {
+    std::lock_guard lock(pending_mutex);
+    delivering.swap(queued);
+  }
+  if (delivering.empty())
+    return 0;
+
+  std::lock_guard lock(subscribers_mutex);
+  for (auto &subscription : subscribers) {
+    if (subscription.filter.accepts_all()) {
+      subscription.observer->on_events(delivering);
+      continue;
+    }
+
+    filtered.clear();
+    for (const auto &event : delivering) {
+      if (subscription.filter.matches(event))
+        filtered.push_back(event);
+    }
+    if (!filtered.empty())
+      subscription.observer->on_events(filtered);
+  }
+  return delivering.size();
+}
+
+std::size_t EventBus::pending() const {
+  std::lock_guard lock(pending_mutex);
+  return queued.size();
+}
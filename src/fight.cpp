@@ -0,0 +1,8 @@
+#include "../include/fight.hpp"
+#include "../include/rules.hpp"
+
+bool resolve_fight(const std::shared_ptr<NPC> &attacker, const std::shared_ptr<NPC> &defender) {
+  bool win = can_kill(attacker->get_type(), defender->get_type());
+  attacker->fight_notify(defender, win);
+  return win;
+}
@@ -0,0 +1,45 @@
+#include "../include/frame.hpp"
+
+FrameBuffer::Handle::~Handle() {
+  if (slot)
+    slot->readers.fetch_sub(1, std::memory_order_release);
+}
+
+bool FrameBuffer::publish(const World &world, std::uint64_t tick) {
+  // front меняет только этот поток, читатели видят его под мьютексом
+  Slot &back = slots[1 - front];
+  if (back.readers.load(std::memory_order_acquire) > 0) {
+    skipped_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  WorldFrame &frame = back.frame;
+  frame.tick = tick;
+  frame.x.assign(world.x.begin(), world.x.end());
+  frame.y.assign(world.y.begin(), world.y.end());
+  frame.type.assign(world.type.begin(), world.type.end());
+  frame.alive.assign(world.alive.begin(), world.alive.end());
+  frame.generation.assign(world.generation.begin(), world.generation.end());
+  frame.active.clear();
+  for (entity_id id : world.active_ids()) {
+    if (world.alive[id])
+      frame.active.push_back(id);
+  }
+  frame.alive_count = world.alive_count();
+
+  {
+    std::lock_guard lock(mutex);
+    front = 1 - front;
+  }
+  published_count.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+FrameBuffer::Handle FrameBuffer::acquire() const {
+  // Счётчик читателей растёт под тем же мьютексом, под которым меняется
+  // front, поэтому задний буфер после смены уже никто не захватит
+  std::lock_guard lock(mutex);
+  Slot &slot = slots[front];
+  slot.readers.fetch_add(1, std::memory_order_acquire);
+  return Handle(&slot);
+}
@@ -0,0 +1,86 @@
+#include "../include/grid.hpp"
+
+#include <cmath>
+
+namespace {
+
+// Наименьший размер ячейки не меньше заданного, при котором сетка
+// на width x height укладывается в max_cells ячеек
+int fit_cell_size(int cell_size, std::int64_t width, std::int64_t height, std::size_t max_cells) {
+  std::int64_t size = std::max(1, cell_size);
+  double area = double(width + 1) * double(height + 1);
+  if (area > double(max_cells))
+    size = std::max<std::int64_t>(size, std::int64_t(std::sqrt(area / double(max_cells))));
+  while (std::uint64_t(width / size + 1) * std::uint64_t(height / size + 1) > max_cells)
+    ++size;
+  return int(size);
+}
+
+} // namespace
+
+SpatialGrid::SpatialGrid(int _cell_size, int max_x, int max_y, int _min_x, int _min_y,
+                         std::size_t max_cells)
+    : min_x(_min_x), min_y(_min_y) {
+  std::int64_t width = std::max<std::int64_t>(0, std::int64_t(max_x) - min_x);
+  std::int64_t height = std::max<std::int64_t>(0, std::int64_t(max_y) - min_y);
+  cell_size = fit_cell_size(_cell_size, width, height, std::max<std::size_t>(1, max_cells));
+  cols = int(width / cell_size + 1);
+  rows = int(height / cell_size + 1);
+  cells.resize(std::size_t(cols) * rows);
+}
+
+void SpatialGrid::clear() {
+  for (int index : occupied) {
+    auto &cell = cells[index];
+    cell.ids.clear();
+    cell.xs.clear();
+    cell.ys.clear();
+    cell.listed = false;
+  }
+  occupied.clear();
+  count = 0;
+}
+
+void SpatialGrid::insert(std::size_t id, int x, int y) {
+  int index = cell_of(x, y);
+  auto &cell = cells[index];
+  if (!cell.listed) {
+    cell.listed = true;
+    occupied.push_back(index);
+  }
+  cell.ids.push_back(id);
+  cell.xs.push_back(x);
+  cell.ys.push_back(y);
+  ++count;
+}
+
+void SpatialGrid::remove(std::size_t id, int x, int y) {
+  auto &cell = cells[cell_of(x, y)];
+  auto it = std::find(cell.ids.begin(), cell.ids.end(), id);
+  if (it == cell.ids.end())
+    return;
+  std::size_t k = it - cell.ids.begin();
+  cell.ids[k] = cell.ids.back();
+  cell.xs[k] = cell.xs.back();
+  cell.ys[k] = cell.ys.back();
+  cell.ids.pop_back();
+  cell.xs.pop_back();
+  cell.ys.pop_back();
+  --count;
+}
+
+void SpatialGrid::update(std::size_t id, int old_x, int old_y, int new_x, int new_y) {
+  if (old_x == new_x && old_y == new_y)
+    return;
+  auto &cell = cells[cell_of(old_x, old_y)];
+  if (&cell != &cells[cell_of(new_x, new_y)]) {
+    remove(id, old_x, old_y);
+    insert(id, new_x, new_y);
+    return;
+  }
+  auto it = std::find(cell.ids.begin(), cell.ids.end(), id);
+  if (it == cell.ids.end())
+    return;
+  cell.xs[it - cell.ids.begin()] = new_x;
+  cell.ys[it - cell.ids.begin()] = new_y;
+}
@@ -0,0 +1,449 @@
+#include "../include/journal.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::string_view kSnapshotPrefix = "snapshot-";
+constexpr std::string_view kJournalPrefix = "journal-";
+constexpr std::string_view kSuffix = ".bin";
+// Бит в байте типа записи смерти: за координатами идёт имя
+constexpr std::uint8_t kNamedDeath = 0x80;
+
+// Номер тика с нулями слева, чтобы имена сортировались как числа
+std::string checkpoint_path(const std::string &dir, std::string_view prefix, std::uint64_t tick) {
+  char digits[21];
+  std::snprintf(digits, sizeof(digits), "%020llu", static_cast<unsigned long long>(tick));
+  return (fs::path(dir) / (std::string(prefix) + digits + std::string(kSuffix))).string();
+}
+
+// Тик из имени файла контрольной точки; false - файл чужой
+bool checkpoint_tick(const std::string &name, std::string_view prefix, std::uint64_t &tick) {
+  std::string_view text = name;
+  if (text.size() <= prefix.size() + kSuffix.size() || text.substr(0, prefix.size()) != prefix ||
+      text.substr(text.size() - kSuffix.size()) != kSuffix)
+    return false;
+  text = text.substr(prefix.size(), text.size() - prefix.size() - kSuffix.size());
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), tick);
+  return error == std::errc() && end == text.data() + text.size();
+}
+
+struct CheckpointFiles {
+  std::vector<std::uint64_t> snapshots;
+  std::vector<std::uint64_t> journals;
+};
+
+CheckpointFiles list_checkpoints(const std::string &dir) {
+  CheckpointFiles files;
+  for (const auto &entry : fs::directory_iterator(dir)) {
+    std::string name = entry.path().filename().string();
+    std::uint64_t tick;
+    if (checkpoint_tick(name, kSnapshotPrefix, tick))
+      files.snapshots.push_back(tick);
+    else if (checkpoint_tick(name, kJournalPrefix, tick))
+      files.journals.push_back(tick);
+  }
+  std::sort(files.snapshots.begin(), files.snapshots.end());
+  std::sort(files.journals.begin(), files.journals.end());
+  return files;
+}
+
+// Убирает снимки и журналы, начатые до tick; keep_newer = false - и после
+void remove_checkpoints(const std::string &dir, std::uint64_t tick, bool keep_newer) {
+  CheckpointFiles files = list_checkpoints(dir);
+  auto obsolete = [&](std::uint64_t t) { return t < tick || (!keep_newer && t > tick); };
+  std::error_code ignored;
+  for (std::uint64_t t : files.snapshots) {
+    if (obsolete(t))
+      fs::remove(checkpoint_path(dir, kSnapshotPrefix, t), ignored);
+  }
+  for (std::uint64_t t : files.journals) {
+    if (obsolete(t))
+      fs::remove(checkpoint_path(dir, kJournalPrefix, t), ignored);
+  }
+}
+
+// Снимок во временный файл и переименование: на диске либо старый, либо целый новый
+void write_snapshot_file(const SnapshotImage &image, const std::string &path) {
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream os(temporary, std::ios::binary | std::ios::trunc);
+    if (!os)
+      throw std::runtime_error("cannot open snapshot for writing: " + temporary);
+    save_snapshot(image, os);
+    if (!os.flush())
+      throw std::runtime_error("failed to write snapshot: " + temporary);
+  }
+  fs::rename(temporary, path);
+}
+
+// Хеш тела блока словами по 8 байт в духе FNV-1a: побайтный FNV на
+// мегабайтах журнала за тик заметен в паузе
+std::uint64_t block_checksum(const char *data, std::size_t size) {
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  for (; i < size; ++i)
+    hash = (hash ^ std::uint8_t(data[i])) * 0x100000001b3ull;
+  return hash ^ size;
+}
+
+// Не больше 10 байт, для 32-битных значений - 5
+char *put_varint(char *out, std::uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = char(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = char(value);
+  return out;
+}
+
+std::uint64_t zigzag(int value) {
+  return (std::uint64_t(std::int64_t(value)) << 1) ^ std::uint64_t(std::int64_t(value) >> 63);
+}
+
+int unzigzag(std::uint64_t value) { return int(std::int64_t(value >> 1) ^ -std::int64_t(value & 1)); }
+
+// Разбор тела блока; любой выход за тело - испорченный блок
+class BlockReader {
+public:
+  explicit BlockReader(std::string_view _data) : data(_data) {}
+
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      std::uint8_t byte = std::uint8_t(take(1)[0]);
+      value |= std::uint64_t(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    throw std::runtime_error("corrupt journal block: varint too long");
+  }
+
+  std::string_view take(std::size_t n) {
+    if (n > data.size() - at)
+      throw std::runtime_error("corrupt journal block: record runs past the end");
+    std::string_view result = data.substr(at, n);
+    at += n;
+    return result;
+  }
+
+  bool done() const { return at == data.size(); }
+
+private:
+  std::string_view data;
+  std::size_t at = 0;
+};
+
+struct LifeEntry {
+  entity_id id;
+  NpcType type;
+  int x;
+  int y;
+  std::string_view name;
+  bool named;
+};
+
+struct MoveEntry {
+  entity_id id;
+  int x;
+  int y;
+};
+
+struct DecodedBlock {
+  std::vector<LifeEntry> died;
+  std::vector<LifeEntry> born;
+  std::vector<MoveEntry> moved;
+};
+
+void decode_life(BlockReader &reader, std::vector<LifeEntry> &out, bool with_names) {
+  std::uint64_t count = reader.varint();
+  std::uint64_t id = 0;
+  for (std::uint64_t k = 0; k < count; ++k) {
+    LifeEntry entry{};
+    id += reader.varint();
+    entry.id = entity_id(id);
+    std::uint8_t type = std::uint8_t(reader.take(1)[0]);
+    entry.named = with_names;
+    if (!with_names && (type & kNamedDeath)) {
+      entry.named = true;
+      type &= ~kNamedDeath;
+    }
+    if (type < KnightType || type > PegasusType || id > UINT32_MAX)
+      throw std::runtime_error("corrupt journal block: bad NPC record");
+    entry.type = NpcType(type);
+    entry.x = unzigzag(reader.varint());
+    entry.y = unzigzag(reader.varint());
+    if (entry.named)
+      entry.name = reader.take(reader.varint());
+    out.push_back(entry);
+  }
+}
+
+DecodedBlock decode_block(std::string_view body) {
+  DecodedBlock block;
+  BlockReader reader(body);
+  decode_life(reader, block.died, false);
+  decode_life(reader, block.born, true);
+  std::uint64_t count = reader.varint();
+  std::uint64_t id = 0;
+  for (std::uint64_t k = 0; k < count; ++k) {
+    id += reader.varint();
+    int x = unzigzag(reader.varint());
+    int y = unzigzag(reader.varint());
+    block.moved.push_back({entity_id(id), x, y});
+  }
+  if (!reader.done())
+    throw std::runtime_error("corrupt journal block: trailing bytes");
+  return block;
+}
+
+// Блок целиком разобран и проверен до первой записи в мир
+void apply_block(World &world, const DecodedBlock &block) {
+  for (const auto &entry : block.moved) {
+    if (entry.id >= world.size() || !world.alive[entry.id])
+      throw std::runtime_error("journal does not match snapshot: move of a dead NPC " +
+                               std::to_string(entry.id));
+  }
+  for (const auto &entry : block.died) {
+    // Слот, занятый и освобождённый за тик, несёт имя нового NPC; без имени
+    // слот ещё не появлялся в мире, только если он новый
+    if (entry.named || entry.id >= world.size())
+      world.restore(entry.id, entry.type, entry.x, entry.y, entry.name);
+    world.type[entry.id] = entry.type;
+    world.x[entry.id] = entry.x;
+    world.y[entry.id] = entry.y;
+    world.kill(entry.id);
+  }
+  for (const auto &entry : block.born)
+    world.restore(entry.id, entry.type, entry.x, entry.y, entry.name);
+  for (const auto &entry : block.moved) {
+    world.x[entry.id] = entry.x;
+    world.y[entry.id] = entry.y;
+  }
+}
+
+// Повтор одного файла журнала; false - встретился оборванный, испорченный
+// или не следующий по порядку блок, дальше повторять нельзя
+bool replay_journal(World &world, const std::string &path, std::uint64_t &tick) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is)
+    return false;
+  std::string body;
+  for (;;) {
+    JournalBlockHeader header;
+    is.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (is.gcount() == 0)
+      return true;
+    if (std::size_t(is.gcount()) != sizeof(header) || std::memcmp(header.magic, kJournalMagic, 4) != 0)
+      return false;
+    body.resize(header.size);
+    is.read(body.data(), header.size);
+    if (std::size_t(is.gcount()) != header.size || block_checksum(body.data(), body.size()) != header.checksum)
+      return false;
+    if (header.tick <= tick)
+      continue;
+    if (header.tick != tick + 1)
+      return false;
+    apply_block(world, decode_block(body));
+    tick = header.tick;
+  }
+}
+
+} // namespace
+
+void encode_journal_block(const World &world, const WorldChanges &changes, std::uint64_t tick,
+                          std::string &out) {
+  // Запас: счётчики и длины имён по 10 байт, id и координаты по 5, тип 1
+  std::size_t bound = sizeof(JournalBlockHeader) + 30 + changes.moved.size() * 15 + changes.died.size() * 16;
+  for (entity_id id : changes.born)
+    bound += 26 + world.name(id).size();
+  for (entity_id id : changes.renamed)
+    bound += 10 + world.name(id).size();
+  out.resize(bound);
+  char *p = out.data() + sizeof(JournalBlockHeader);
+
+  // renamed - подсписок died по возрастанию, идёт рядом с ним
+  auto put_life = [&](const std::vector<entity_id> &ids, bool with_names) {
+    p = put_varint(p, ids.size());
+    entity_id previous = 0;
+    auto renamed = changes.renamed.begin();
+    for (entity_id id : ids) {
+      p = put_varint(p, id - previous);
+      previous = id;
+      bool flagged = !with_names && renamed != changes.renamed.end() && *renamed == id;
+      if (flagged)
+        ++renamed;
+      *p++ = char(world.type[id] | (flagged ? kNamedDeath : 0));
+      p = put_varint(p, zigzag(world.x[id]));
+      p = put_varint(p, zigzag(world.y[id]));
+      if (with_names || flagged) {
+        std::string_view name = world.name(id);
+        p = put_varint(p, name.size());
+        p = std::copy(name.begin(), name.end(), p);
+      }
+    }
+  };
+  put_life(changes.died, false);
+  put_life(changes.born, true);
+  p = put_varint(p, changes.moved.size());
+  entity_id previous = 0;
+  for (entity_id id : changes.moved) {
+    p = put_varint(p, id - previous);
+    previous = id;
+    p = put_varint(p, zigzag(world.x[id]));
+    p = put_varint(p, zigzag(world.y[id]));
+  }
+  out.resize(std::size_t(p - out.data()));
+
+  JournalBlockHeader header{};
+  std::memcpy(header.magic, kJournalMagic, sizeof(header.magic));
+  header.size = std::uint32_t(out.size() - sizeof(header));
+  header.tick = tick;
+  header.checksum = block_checksum(out.data() + sizeof(header), header.size);
+  std::memcpy(out.data(), &header, sizeof(header));
+}
+
+Checkpointer::Checkpointer(World &_world, const std::string &_dir, std::uint64_t _snapshot_every,
+                           std::uint64_t tick)
+    : world(_world), dir(_dir), snapshot_every(std::max<std::uint64_t>(_snapshot_every, 1)),
+      snapshot_tick(tick) {
+  fs::create_directories(dir);
+  // Изменения считаются от начального снимка
+  world.track_changes(true);
+  capture_snapshot(world, image);
+  write_snapshot_file(image, checkpoint_path(dir, kSnapshotPrefix, tick));
+  remove_checkpoints(dir, tick, false);
+  open_journal(tick);
+  counters.snapshot_tick = tick;
+  writer = std::thread([this] { writer_loop(); });
+}
+
+Checkpointer::~Checkpointer() {
+  {
+    std::lock_guard lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  writer.join();
+  world.track_changes(false);
+}
+
+void Checkpointer::open_journal(std::uint64_t tick) {
+  journal.close();
+  journal_path = checkpoint_path(dir, kJournalPrefix, tick);
+  journal.open(journal_path, std::ios::binary | std::ios::trunc);
+  if (!journal)
+    throw std::runtime_error("cannot open journal for writing: " + journal_path);
+}
+
+void Checkpointer::commit(std::uint64_t tick) {
+  Metrics::Scope scope(metrics, Timer::Checkpoint);
+  TRACE_SCOPE("checkpoint");
+  {
+    std::lock_guard lock(mutex);
+    if (error)
+      std::rethrow_exception(std::exchange(error, nullptr));
+  }
+
+  world.collect_changes(changes);
+  encode_journal_block(world, changes, tick, block);
+  journal.write(block.data(), std::streamsize(block.size()));
+  if (!journal.flush())
+    throw std::runtime_error("failed to write journal: " + journal_path);
+
+  std::unique_lock lock(mutex);
+  ++counters.blocks;
+  counters.journal_bytes += block.size();
+  if (tick < snapshot_tick + snapshot_every || busy)
+    return;
+
+  // Копия мира в память - единственная часть снимка на потоке тика
+  {
+    TRACE_SCOPE("snapshot capture");
+    capture_snapshot(world, image);
+  }
+  image_tick = tick;
+  busy = true;
+  lock.unlock();
+  wake.notify_one();
+
+  // Блоки после снимка идут в новый журнал
+  snapshot_tick = tick;
+  open_journal(tick);
+}
+
+void Checkpointer::wait() {
+  std::unique_lock lock(mutex);
+  idle.wait(lock, [&] { return !busy; });
+  if (error)
+    std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+CheckpointStats Checkpointer::stats() const {
+  std::lock_guard lock(mutex);
+  return counters;
+}
+
+void Checkpointer::writer_loop() {
+  TRACE_THREAD_NAME("checkpoint");
+  std::unique_lock lock(mutex);
+  for (;;) {
+    wake.wait(lock, [&] { return busy || stop; });
+    if (!busy)
+      return;
+
+    std::uint64_t tick = image_tick;
+    lock.unlock();
+    std::exception_ptr failure;
+    try {
+      TRACE_SCOPE("snapshot write");
+      write_snapshot_file(image, checkpoint_path(dir, kSnapshotPrefix, tick));
+      remove_checkpoints(dir, tick, true);
+    } catch (...) {
+      failure = std::current_exception();
+    }
+    lock.lock();
+
+    if (failure) {
+      error = failure;
+    } else {
+      ++counters.snapshots;
+      counters.snapshot_tick = tick;
+    }
+    busy = false;
+    idle.notify_all();
+  }
+}
+
+std::uint64_t recover(World &world, const std::string &dir) {
+  CheckpointFiles files = list_checkpoints(dir);
+  if (files.snapshots.empty())
+    throw std::runtime_error("no snapshot in checkpoint directory: " + dir);
+
+  std::uint64_t tick = files.snapshots.back();
+  SnapshotView(checkpoint_path(dir, kSnapshotPrefix, tick)).load_into(world);
+  // Журналы, начатые раньше снимка, целиком в нём
+  for (std::uint64_t start : files.journals) {
+    if (start < files.snapshots.back())
+      continue;
+    if (!replay_journal(world, checkpoint_path(dir, kJournalPrefix, start), tick))
+      break;
+  }
+  return tick;
+}
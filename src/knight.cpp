@@ -1,16 +1,19 @@
 #include "../include/dragon.hpp"
 #include "../include/knight.hpp"
 #include "../include/pegasus.hpp"
+#include "../include/rules.hpp"
 
 Knight::Knight(int x, int y, const std::string &name)
     : NPC(KnightType, x, y, name) {}
 
 Knight::Knight(std::istream &is) : NPC(KnightType, is) {}
 
+Knight::Knight(World &world, std::uint32_t id) : NPC(world, id) {}
+
 void Knight::print() { std::cout << *this; }
 
 void Knight::save(std::ostream &os) {
-  os << KnightType << std::endl;
+  os << KnightType << '\n';
   NPC::save(os);
 }
 
@@ -23,18 +26,21 @@ bool Knight::accept(std::shared_ptr<NPC> attacker) {
 }
 
 bool Knight::visit(Knight &other) {
-  fight_notify(other.shared_from_this(), false);
-  return false;
+  bool win = can_kill(KnightType, KnightType);
+  fight_notify(other.shared_from_this(), win);
+  return win;
 }
 
 bool Knight::visit(Dragon &other) {
-  fight_notify(other.shared_from_this(), true);
-  return true;
+  bool win = can_kill(KnightType, DragonType);
+  fight_notify(other.shared_from_this(), win);
+  return win;
 }
 
 bool Knight::visit(Pegasus &other) {
-  fight_notify(other.shared_from_this(), false);
-  return false;
+  bool win = can_kill(KnightType, PegasusType);
+  fight_notify(other.shared_from_this(), win);
+  return win;
 }
 
 std::ostream &operator<<(std::ostream &os, Knight &knight) {
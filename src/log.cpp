@@ -0,0 +1,173 @@
+#include "../include/log.hpp"
+#include "../include/trace.hpp"
+
+#include <string>
+
+namespace {
+
+std::atomic<std::uint64_t> next_instance{1};
+
+} // namespace
+
+// Кольцо одного производителя и одного потребителя (фонового потока)
+struct AsyncLogger::Ring {
+  explicit Ring(std::size_t capacity) : records(capacity) {}
+
+  std::vector<LogRecord> records;
+  alignas(64) std::atomic<std::size_t> head{0};
+  alignas(64) std::atomic<std::size_t> tail{0};
+
+  bool try_push(const LogRecord &record) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == records.size())
+      return false;
+    records[t % records.size()] = record;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t pop_all(std::vector<LogRecord> &out) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    std::size_t t = tail.load(std::memory_order_acquire);
+    for (std::size_t i = h; i < t; ++i)
+      out.push_back(records[i % records.size()]);
+    head.store(t, std::memory_order_release);
+    return t - h;
+  }
+};
+
+AsyncLogger::AsyncLogger(const World &_world, Options _options)
+    : world(_world), options(_options), instance(next_instance++) {
+  writer = std::thread(&AsyncLogger::writer_loop, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  writer.join();
+}
+
+void AsyncLogger::add_sink(std::ostream &os, std::mutex *guard) {
+  std::lock_guard lock(mutex);
+  sinks.push_back({&os, guard});
+}
+
+AsyncLogger::Ring &AsyncLogger::local_ring() {
+  // Кольца текущего потока по журналам: каждая пара (поток, журнал)
+  // регистрирует ровно одно кольцо, сколько бы поток ни чередовал журналы.
+  // instance не повторяется, поэтому запись умершего журнала просто не
+  // совпадёт ни с одним живым.
+  thread_local std::vector<std::pair<std::uint64_t, Ring *>> cached;
+  for (auto &[id, ring] : cached) {
+    if (id == instance)
+      return *ring;
+  }
+  Ring *ring;
+  {
+    std::lock_guard lock(rings_mutex);
+    rings.push_back(std::make_unique<Ring>(options.ring_capacity));
+    ring = rings.back().get();
+  }
+  cached.emplace_back(instance, ring);
+  return *ring;
+}
+
+void AsyncLogger::log(LogEvent event, std::uint64_t tick, entity_id attacker, entity_id defender) {
+  Ring &ring = local_ring();
+  LogRecord record{tick, attacker, defender, event};
+  while (!ring.try_push(record)) {
+    if (options.overflow == OverflowPolicy::Drop) {
+      dropped_count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    wake.notify_one();
+    std::this_thread::yield();
+  }
+}
+
+void AsyncLogger::flush() {
+  std::unique_lock lock(mutex);
+  std::uint64_t target = ++flush_requested;
+  wake.notify_one();
+  flushed.wait(lock, [&] { return flush_completed >= target; });
+}
+
+std::size_t AsyncLogger::drain(std::vector<LogRecord> &out) {
+  std::lock_guard lock(rings_mutex);
+  std::size_t count = 0;
+  for (auto &ring : rings)
+    count += ring->pop_all(out);
+  return count;
+}
+
+void AsyncLogger::write_batch(const std::vector<LogRecord> &records, const std::vector<Sink> &targets) {
+  if (records.empty())
+    return;
+
+  Metrics::Scope scope(options.metrics, Timer::Log);
+  TRACE_SCOPE("log");
+
+  std::string text;
+  text.reserve(records.size() * 40);
+  {
+    std::shared_lock lock(world.get_mutex());
+    for (const auto &record : records) {
+      text += record.event == LogEvent::Kill ? "Murder: " : "Fight: ";
+      text += world.name(record.attacker);
+      text += record.event == LogEvent::Kill ? " killed " : " vs ";
+      text += world.name(record.defender);
+      text += '\n';
+    }
+  }
+
+  for (const auto &sink : targets) {
+    std::unique_lock<std::mutex> lock;
+    if (sink.guard)
+      lock = std::unique_lock(*sink.guard);
+    sink.os->write(text.data(), text.size());
+    sink.os->flush();
+  }
+  written_count.fetch_add(records.size(), std::memory_order_relaxed);
+}
+
+void AsyncLogger::writer_loop() {
+  TRACE_THREAD_NAME("log writer");
+  std::vector<LogRecord> batch;
+  std::vector<Sink> targets;
+  while (true) {
+    std::uint64_t requested;
+    bool stop;
+    {
+      std::unique_lock lock(mutex);
+      wake.wait_for(lock, options.flush_interval,
+                    [&] { return stopping || flush_requested != flush_completed; });
+      requested = flush_requested;
+      stop = stopping;
+      targets = sinks;
+    }
+
+    batch.clear();
+    drain(batch);
+    write_batch(batch, targets);
+
+    {
+      std::lock_guard lock(mutex);
+      flush_completed = requested;
+    }
+    flushed.notify_all();
+
+    if (stop)
+      return;
+  }
+}
+
+LogObserver::LogObserver(AsyncLogger &_logger) : logger(_logger) {}
+
+void LogObserver::on_events(const std::vector<FightOutcome> &events) {
+  for (const auto &event : events)
+    logger.log(event.kind == FightKind::Kill ? LogEvent::Kill : LogEvent::Fight, event.tick,
+               event.attacker, event.defender);
+}
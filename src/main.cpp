@@ -2,230 +2,413 @@
 #include "../include/knight.hpp"
 #include "../include/pegasus.hpp"
 #include "../include/npc.hpp"
+#include "../include/combat.hpp"
+#include "../include/config.hpp"
+#include "../include/frame.hpp"
+#include "../include/log.hpp"
+#include "../include/metrics.hpp"
+#include "../include/movement.hpp"
+#include "../include/render.hpp"
+#include "../include/shard.hpp"
+#include "../include/simulation.hpp"
+#include "../include/snapshot.hpp"
+#include "../include/trace.hpp"
+#include "../include/world.hpp"
 
 #include <thread>
 #include <mutex>
-#include <queue>
 #include <chrono>
 #include <atomic>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 
 std::mutex print_mutex;
-std::mutex queue_mutex;
 
-struct FightEvent {
-  std::shared_ptr<NPC> attacker;
-  std::shared_ptr<NPC> defender;
-};
-
-std::queue<FightEvent> fight_queue;
+Metrics metrics;
 std::atomic<bool> game_running{true};
 
-class ConsoleObserver : public IFightObserver {
-private:
-  ConsoleObserver() {}
-
-public:
-  static std::shared_ptr<IFightObserver> get() {
-    static ConsoleObserver instance;
-    return std::shared_ptr<IFightObserver>(&instance, [](IFightObserver *) {});
+// Поток тика. Фазы идут по очереди, и каждая владеет тем, что пишет:
+// движение и поиск пар - координатами и сеткой, бои - флагами жизни.
+// Поэтому внутри тика блокировки мира не нужны, а остальные потоки
+// читают только опубликованный кадр. Бои проводятся здесь же, пачкой
+// CombatBatch, как и в безголовом режиме.
+void tick_thread(World& world, std::vector<std::shared_ptr<NPC>>& npcs, FrameBuffer& frames,
+                 const SimulationConfig& config) {
+  TRACE_THREAD_NAME("tick");
+  const std::uint64_t seed = config.seed;
+  ThreadPool pool(config.threads);
+  MovementSystem movement(world, config.max_x, config.max_y, seed, &pool, config.tile_size);
+  movement.set_metrics(&metrics);
+  std::unique_ptr<BehaviorScheduler> behaviors;
+  if (config.behaviors) {
+    behaviors = std::make_unique<BehaviorScheduler>(world, config.max_x, config.max_y, seed, &pool);
+    behaviors->set_metrics(&metrics);
+    attach_default_behaviors(*behaviors, world);
   }
+  CombatBatch combat;
 
-  void on_fight(const std::shared_ptr<NPC> attacker,
-                const std::shared_ptr<NPC> defender, bool win) override {
-    if (win) {
-      std::lock_guard<std::mutex> lock(print_mutex);
-      std::cout << "Murder: " << attacker->get_name() << " killed " 
-                << defender->get_name() << std::endl;
+  while (game_running) {
+    {
+      TRACE_SCOPE("tick");
+
+      // Поведения, движение и поиск пар
+      std::uint64_t tick = movement.get_tick();
+      world.events.set_tick(tick);
+      if (behaviors)
+        behaviors->run(tick);
+      combat.build(movement.tick());
+
+      // Бои - той же пачкой и теми же кубиками, что в безголовом режиме
+      combat.resolve(world, npcs, seed, tick, &pool, &metrics);
+
+      // Итоги боёв раздаются подписчикам шины одной пачкой, кадр - читателям
+      {
+        Metrics::Scope scope(&metrics, Timer::Notify);
+        TRACE_SCOPE("notify");
+        world.events.dispatch();
+      }
+      TRACE_SCOPE("frame");
+      frames.publish(world, movement.get_tick());
     }
-  }
-};
-
-class FileObserver : public IFightObserver {
-private:
-  std::ofstream log_file;
-  std::mutex file_mutex;
-
-  FileObserver() : log_file("log.txt", std::ios::app) {}
 
-public:
-  static std::shared_ptr<IFightObserver> get() {
-    static FileObserver instance;
-    return std::shared_ptr<IFightObserver>(&instance, [](IFightObserver *) {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
+}
 
-  void on_fight(const std::shared_ptr<NPC> attacker,
-                const std::shared_ptr<NPC> defender, bool win) override {
-    if (win) {
-      std::lock_guard<std::mutex> lock(file_mutex);
-      if (log_file.is_open()) {
-        log_file << "Murder: " << attacker->get_name() << " killed " 
-                 << defender->get_name() << std::endl;
-      }
+// Печать карты по последнему опубликованному кадру. Текст собирается в один
+// буфер без блокировок; print_mutex, общий только с журналом, берётся
+// на единственную запись в stdout
+void print_map(const World& world, const FrameBuffer& frames, MapRenderer& renderer, std::string& out) {
+  out.clear();
+  {
+    auto frame = frames.acquire();
+    out += "\n====== MAP (tick " + std::to_string(frame->tick) + ") ======\n";
+    {
+      // Имена меняются только при рождении NPC, а рождение - структурная операция
+      std::shared_lock names_lock(world.get_mutex());
+      renderer.render(*frame, world, out);
     }
+    out += "Alive: " + std::to_string(frame->alive_count) + "/" + std::to_string(frame->size()) + "\n";
   }
 
-  ~FileObserver() {
-    if (log_file.is_open())
-      log_file.close();
-  }
-};
-
-std::shared_ptr<NPC> factory(NpcType type, int x, int y, const std::string &name) {
-  std::shared_ptr<NPC> result;
-  switch (type) {
-  case KnightType:
-    result = std::make_shared<Knight>(x, y, name);
-    break;
-  case DragonType:
-    result = std::make_shared<Dragon>(x, y, name);
-    break;
-  case PegasusType:
-    result = std::make_shared<Pegasus>(x, y, name);
-    break;
-  default:
-    return nullptr;
-  }
+  MetricsSnapshot totals = metrics.snapshot();
+  out += "Fights: resolved " + std::to_string(totals.counter(Counter::FightsResolved)) + ", kills " +
+         std::to_string(totals.counter(Counter::Kills)) + "\n";
+  out += "======================\n\n";
 
-  if (result) {
-    result->subscribe(ConsoleObserver::get());
-    result->subscribe(FileObserver::get());
-  }
+  std::lock_guard<std::mutex> lock(print_mutex);
+  std::cout.write(out.data(), out.size());
+  std::cout.flush();
+}
 
-  return result;
+bool is_text_path(const std::string& path) {
+  return path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0;
 }
 
-std::string generate_name(NpcType type, int index) {
-  switch (type) {
-  case KnightType:
-    return "Knight_" + std::to_string(index);
-  case DragonType:
-    return "Dragon_" + std::to_string(index);
-  case PegasusType:
-    return "Pegasus_" + std::to_string(index);
-  default:
-    return "Unknown_" + std::to_string(index);
+// Загрузка мира: .txt - текстовый формат NPC::save, иначе бинарный снимок.
+// Нечитаемый или испорченный файл - std::runtime_error
+void load_world(World& world, std::vector<std::shared_ptr<NPC>>& npcs, const std::string& path,
+                ThreadPool* pool) {
+  if (is_text_path(path)) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+      throw std::runtime_error("cannot open " + path);
+    import_text(world, is, pool);
+  } else {
+    SnapshotView(path).load_into(world);
   }
+  for (entity_id i = 0; i < world.size(); ++i)
+    npcs.push_back(make_handle(world, i));
 }
 
-// Поток движения
-void movement_thread(std::vector<std::shared_ptr<NPC>>& npcs, int max_x, int max_y) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dir_dist(-1, 1);
+void save_world(const World& world, const std::string& path) {
+  if (is_text_path(path)) {
+    std::ofstream os(path);
+    export_text(world, os);
+  } else {
+    save_snapshot(world, path);
+  }
+}
 
-  while (game_running) {
-    for (size_t i = 0; i < npcs.size(); ++i) {
-      auto& npc1 = npcs[i];
-      if (!npc1->is_alive()) continue;
-
-      // Движение NPC
-      int move_dist = npc1->get_move_distance();
-      int dx = dir_dist(gen) * move_dist;
-      int dy = dir_dist(gen) * move_dist;
-      npc1->move(dx, dy, max_x, max_y);
-
-      // Проверка на возможность боя
-      for (size_t j = 0; j < npcs.size(); ++j) {
-        if (i == j) continue;
-        
-        auto& npc2 = npcs[j];
-        if (!npc2->is_alive()) continue;
-
-        int kill_dist = npc1->get_kill_distance();
-        if (npc1->is_close(npc2, kill_dist)) {
-          std::lock_guard<std::mutex> lock(queue_mutex);
-          fight_queue.push({npc1, npc2});
-        }
+// Безголовый режим: фиксированный шаг без пауз, он же замер тиков в секунду
+int run_headless(SimulationConfig config, const std::string& load_path, const std::string& recover_path,
+                 const std::string& save_path, const std::string& metrics_path, size_t shards) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  configure_world(world, config);
+  if (!recover_path.empty()) {
+    // Прогон продолжается с восстановленного тика до того же --ticks
+    try {
+      config.start_tick = std::min(recover(world, recover_path), config.ticks);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    for (entity_id i = 0; i < world.size(); ++i)
+      npcs.push_back(make_handle(world, i));
+    std::cerr << "Recovered " << world.alive_count() << " NPCs at tick " << config.start_tick << std::endl;
+  } else {
+    // Пул только на время расстановки: рабочие процессы шардов отделяются,
+    // когда его потоки уже остановлены
+    ThreadPool startup(config.threads);
+    if (load_path.empty()) {
+      populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed, &startup);
+    } else {
+      try {
+        load_world(world, npcs, load_path, &startup);
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
       }
     }
+  }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  size_t kills = 0;
+  const std::uint64_t ticks = config.ticks - config.start_tick;
+  auto start_time = std::chrono::steady_clock::now();
+  if (shards > 1) {
+    // Рабочие процессы отделяются до запуска каких-либо потоков
+    ShardCoordinator coordinator(world, npcs, config, shards);
+    coordinator.set_metrics(&metrics);
+    for (std::uint64_t tick = 0; tick < ticks; ++tick)
+      kills += coordinator.step();
+    coordinator.collect();
+
+    const ShardStats& stats = coordinator.stats();
+    std::cerr << "Shards: " << coordinator.shard_count() << ", migrated " << stats.migrated
+              << ", guests " << stats.guests << ", sent " << stats.bytes_sent << " B, received "
+              << stats.bytes_received << " B" << std::endl;
+  } else {
+    ThreadPool pool(config.threads);
+    Simulation simulation(world, npcs, config, &pool);
+    simulation.set_metrics(&metrics);
+    for (std::uint64_t tick = 0; tick < ticks; ++tick)
+      kills += simulation.step();
+    if (auto* checkpoints = simulation.get_checkpoints()) {
+      checkpoints->wait();
+      std::cerr << "Checkpoints: " << checkpoints->stats().blocks << " journal blocks, "
+                << checkpoints->stats().journal_bytes << " B, last snapshot at tick "
+                << checkpoints->stats().snapshot_tick << std::endl;
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  std::cout << "Seed: " << config.seed << std::endl;
+  std::cout << "Ticks: " << config.ticks << ", kills: " << kills << std::endl;
+  std::cout << "Survived: " << world.alive_count() << "/" << world.size() << std::endl;
+  std::cout << "State hash: " << std::hex << world_hash(world) << std::dec << std::endl;
+  std::cerr << "Time: " << seconds << " s, ticks/s: " << (seconds > 0 ? ticks / seconds : 0)
+            << std::endl;
+
+  if (!metrics_path.empty()) {
+    std::ofstream metrics_file(metrics_path, std::ios::app);
+    write_metrics_json(metrics_file, metrics.snapshot(), ticks);
   }
-}
 
-// Поток боёв
-void fight_thread(std::vector<std::shared_ptr<NPC>>& npcs) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dice(1, 6);
+  if (!save_path.empty())
+    save_world(world, save_path);
+  return 0;
+}
 
-  while (game_running) {
-    FightEvent event;
-    bool has_event = false;
+// Трасса пишется в конце прогона, когда потоки тика уже остановлены
+void write_trace(const std::string& path) {
+  if (path.empty())
+    return;
+  Tracer::global().stop();
+  std::ofstream os(path);
+  Tracer::global().write_chrome_json(os);
+  std::cerr << "Trace: " << Tracer::global().recorded() << " events to " << path;
+  if (Tracer::global().dropped() > 0)
+    std::cerr << " (" << Tracer::global().dropped() << " dropped)";
+  std::cerr << std::endl;
+}
 
-    {
-      std::lock_guard<std::mutex> lock(queue_mutex);
-      if (!fight_queue.empty()) {
-        event = fight_queue.front();
-        fight_queue.pop();
-        has_event = true;
-      }
-    }
+// Число из аргумента целиком; "abc", "-1" для беззнакового и переполнение - false
+template <class T> bool parse_arg(const char* text, T& value) {
+  const char* end = text + std::strlen(text);
+  auto result = std::from_chars(text, end, value);
+  return result.ec == std::errc() && result.ptr == end && end != text;
+}
 
-    if (has_event) {
-      if (!event.attacker->is_alive() || !event.defender->is_alive()) {
-        continue;
-      }
+void print_usage(const char* program) {
+  std::cout << "Usage: " << program << " [--config FILE] [--headless] [--seed N] [--npcs N]"
+            << " [--map W H] [--tile N] [--ticks N] [--threads N] [--shards N] [--behaviors]"
+            << " [--load FILE] [--save FILE] [--checkpoint DIR] [--checkpoint-every N] [--recover DIR]"
+            << " [--log-overflow drop|block] [--metrics FILE] [--trace FILE]"
+            << " [--render list|density|diff]" << std::endl;
+}
 
-      int attack_roll = dice(gen);
-      int defense_roll = dice(gen);
+int main(int argc, char** argv) {
+  const int GAME_DURATION = 30; // секунд
 
-      if (attack_roll > defense_roll) {
-        bool can_kill = event.defender->accept(event.attacker);
-        if (can_kill) {
-          event.defender->set_alive(false);
-        }
+  SimulationConfig config;
+  config.seed = std::random_device{}();
+  config.threads = ThreadPool::default_threads();
+  bool headless = false;
+  std::string load_path, save_path, recover_path;
+  std::string metrics_path, trace_path;
+  AsyncLogger::Options log_options;
+  std::string render_name;
+  size_t shards = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    auto has_value = [&](int count) { return i + count < argc; };
+    const char* flag = argv[i];
+    bool parsed = true;
+    if (!std::strcmp(argv[i], "--headless")) {
+      headless = true;
+    } else if (!std::strcmp(argv[i], "--config") && has_value(1)) {
+      // Флаги после --config перекрывают значения из файла
+      try {
+        load_config_file(argv[++i], config);
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+    } else if (!std::strcmp(argv[i], "--seed") && has_value(1)) {
+      parsed = parse_arg(argv[++i], config.seed);
+    } else if (!std::strcmp(argv[i], "--npcs") && has_value(1)) {
+      parsed = parse_arg(argv[++i], config.npc_count);
+    } else if (!std::strcmp(argv[i], "--map") && has_value(2)) {
+      parsed = parse_arg(argv[++i], config.max_x) && parse_arg(argv[++i], config.max_y);
+    } else if (!std::strcmp(argv[i], "--behaviors")) {
+      config.behaviors = true;
+    } else if (!std::strcmp(argv[i], "--shards") && has_value(1)) {
+      parsed = parse_arg(argv[++i], shards);
+    } else if (!std::strcmp(argv[i], "--tile") && has_value(1)) {
+      parsed = parse_arg(argv[++i], config.tile_size);
+    } else if (!std::strcmp(argv[i], "--ticks") && has_value(1)) {
+      parsed = parse_arg(argv[++i], config.ticks);
+    } else if (!std::strcmp(argv[i], "--threads") && has_value(1)) {
+      parsed = parse_arg(argv[++i], config.threads);
+    } else if (!std::strcmp(argv[i], "--load") && has_value(1)) {
+      load_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--save") && has_value(1)) {
+      save_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--checkpoint") && has_value(1)) {
+      config.checkpoint_dir = argv[++i];
+    } else if (!std::strcmp(argv[i], "--checkpoint-every") && has_value(1)) {
+      parsed = parse_arg(argv[++i], config.checkpoint_every);
+    } else if (!std::strcmp(argv[i], "--recover") && has_value(1)) {
+      recover_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--trace") && has_value(1)) {
+      trace_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--render") && has_value(1)) {
+      render_name = argv[++i];
+    } else if (!std::strcmp(argv[i], "--metrics") && has_value(1)) {
+      metrics_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--log-overflow") && has_value(1)) {
+      ++i;
+      if (!std::strcmp(argv[i], "drop")) {
+        log_options.overflow = OverflowPolicy::Drop;
+      } else if (!std::strcmp(argv[i], "block")) {
+        log_options.overflow = OverflowPolicy::Block;
+      } else {
+        print_usage(argv[0]);
+        return 1;
       }
+    } else {
+      print_usage(argv[0]);
+      return 1;
     }
+    if (!parsed) {
+      std::cerr << "Invalid value for " << flag << std::endl;
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  try {
+    validate_config(config);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  // Сопрограммы поведений живут в одном процессе, шарды их не переносят
+  if (config.behaviors && headless && shards > 1) {
+    std::cerr << "--behaviors is not supported with --shards" << std::endl;
+    return 1;
+  }
+  // Журнал пишет Simulation безголового режима в одном процессе
+  bool checkpoints = !config.checkpoint_dir.empty() || !recover_path.empty();
+  if (checkpoints && (!headless || shards > 1 || config.behaviors)) {
+    std::cerr << "--checkpoint and --recover need --headless without --shards and --behaviors" << std::endl;
+    return 1;
+  }
+  if (!recover_path.empty() && !load_path.empty()) {
+    std::cerr << "--recover and --load cannot be combined" << std::endl;
+    return 1;
   }
-}
 
-// Печать карты
-void print_map(const std::vector<std::shared_ptr<NPC>>& npcs, int max_x, int max_y) {
-  std::lock_guard<std::mutex> lock(print_mutex);
-  
-  std::cout << "\n====== MAP ======" << std::endl;
-  for (const auto& npc : npcs) {
-    if (npc->is_alive()) {
-      std::cout << npc->get_name() << " at (" << npc->get_x() << ", " 
-                << npc->get_y() << ")" << std::endl;
+  if (!trace_path.empty()) {
+    if (!DUNGEON_TRACE) {
+      std::cerr << "Tracing is compiled out (DUNGEON_TRACE=OFF), --trace ignored" << std::endl;
+      trace_path.clear();
+    } else {
+      Tracer::global().start();
+      TRACE_THREAD_NAME("main");
     }
   }
-  
-  int alive_count = 0;
-  for (const auto& npc : npcs) {
-    if (npc->is_alive()) alive_count++;
+
+  if (headless) {
+    int result = run_headless(config, load_path, recover_path, save_path, metrics_path, shards);
+    write_trace(trace_path);
+    return result;
   }
-  std::cout << "Alive: " << alive_count << "/" << npcs.size() << std::endl;
-  std::cout << "======================\n" << std::endl;
-}
 
-int main() {
-  const int MAX_X = 100;
-  const int MAX_Y = 100;
-  const int NPC_COUNT = 50;
-  const int GAME_DURATION = 30; // секунд
+  // В реальном времени метрики пишутся всегда, раз в секунду рядом с картой
+  if (metrics_path.empty())
+    metrics_path = "metrics.jsonl";
+  log_options.metrics = &metrics;
 
+  World world;
   std::vector<std::shared_ptr<NPC>> npcs;
+  configure_world(world, config);
+
+  if (load_path.empty()) {
+    std::cout << "Generating " << config.npc_count << " NPCs (seed " << config.seed << ")..." << std::endl;
+    ThreadPool startup(config.threads);
+    populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed, &startup);
+  } else {
+    std::cout << "Loading NPCs from " << load_path << "..." << std::endl;
+    ThreadPool startup(config.threads);
+    try {
+      load_world(world, npcs, load_path, &startup);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
 
-  std::cout << "Generating " << NPC_COUNT << " NPCs..." << std::endl;
-  std::srand(std::time(nullptr));
-  
-  for (int i = 0; i < NPC_COUNT; ++i) {
-    NpcType type = NpcType(std::rand() % 3 + 1);
-    std::string name = generate_name(type, i);
-    int x = std::rand() % (MAX_X + 1);
-    int y = std::rand() % (MAX_Y + 1);
-    npcs.push_back(factory(type, x, y, name));
+  // Без явного режима большой мир печатается сеткой плотности: список из
+  // десятков тысяч строк раз в секунду читать невозможно
+  RenderMode render_mode = world.size() > 1000 ? RenderMode::Density : RenderMode::List;
+  if (!render_name.empty() && !parse_render_mode(render_name, render_mode)) {
+    print_usage(argv[0]);
+    return 1;
   }
+  MapRenderer renderer(render_mode, config.max_x, config.max_y);
+  std::string map_text;
+
+  // Наблюдатель только кладёт записи в журнал, печать идёт в фоновом потоке
+  std::ofstream log_file("log.txt", std::ios::app);
+  AsyncLogger logger(world, log_options);
+  logger.add_sink(std::cout, &print_mutex);
+  if (log_file.is_open())
+    logger.add_sink(log_file);
+  world.events.subscribe(std::make_shared<LogObserver>(logger), EventFilter::only(FightKind::Kill));
 
   std::cout << "Starting game for " << GAME_DURATION << " seconds..." << std::endl;
 
+  std::ofstream metrics_file(metrics_path, std::ios::app);
+
   // Запуск потоков
-  std::thread move_thread(movement_thread, std::ref(npcs), MAX_X, MAX_Y);
-  std::thread combat_thread(fight_thread, std::ref(npcs));
+  FrameBuffer frames;
+  frames.publish(world, 0);
+  std::thread game_thread(tick_thread, std::ref(world), std::ref(npcs), std::ref(frames),
+                          std::cref(config));
 
   // Главный поток - печать карты каждую секунду
   auto start_time = std::chrono::steady_clock::now();
@@ -238,31 +421,36 @@ int main() {
       break;
     }
 
-    print_map(npcs, MAX_X, MAX_Y);
+    print_map(world, frames, renderer, map_text);
+    if (metrics_file.is_open()) {
+      write_metrics_json(metrics_file, metrics.snapshot(), frames.acquire()->tick);
+      metrics_file.flush();
+    }
     std::this_thread::sleep_for(std::chrono::seconds(1));
   }
 
   game_running = false;
 
-  move_thread.join();
-  combat_thread.join();
+  game_thread.join();
+  logger.flush();
+  if (logger.dropped() > 0)
+    std::cout << "Log records dropped: " << logger.dropped() << std::endl;
+  write_trace(trace_path);
 
   // Финальный отчёт
   std::cout << "\n===== GAME OVER =====" << std::endl;
   std::cout << "Survivors:" << std::endl;
-  for (const auto& npc : npcs) {
-    if (npc->is_alive()) {
-      std::cout << "  " << npc->get_name() << " at (" << npc->get_x() 
-                << ", " << npc->get_y() << ")" << std::endl;
-    }
+  world.compact();
+  for (entity_id i : world.active_ids()) {
+    std::cout << "  " << world.name(i) << " at (" << world.x[i] 
+              << ", " << world.y[i] << ")" << std::endl;
   }
 
-  int alive_count = 0;
-  for (const auto& npc : npcs) {
-    if (npc->is_alive()) alive_count++;
-  }
-  
-  std::cout << "\nTotal survived: " << alive_count << "/" << NPC_COUNT << std::endl;
+  std::cout << "\nTotal survived: " << world.alive_count() << "/" << world.size()
+            << ", graveyard: " << world.graveyard().size() << std::endl;
+
+  if (!save_path.empty())
+    save_world(world, save_path);
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,132 @@
+#include "../include/metrics.hpp"
+
+#include <algorithm>
+
+namespace {
+
+std::atomic<std::uint64_t> next_instance{1};
+
+constexpr const char *kTimerNames[] = {"behave", "move", "detect", "fight", "notify", "log", "checkpoint"};
+constexpr const char *kCounterNames[] = {"pairs_tested", "fights_resolved", "kills"};
+
+static_assert(std::size(kTimerNames) == std::size_t(Timer::Count));
+static_assert(std::size(kCounterNames) == std::size_t(Counter::Count));
+
+// Поле блока пишет только его поток, поэтому хватает load + store
+void bump(std::atomic<std::uint64_t> &value, std::uint64_t n) {
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void raise(std::atomic<std::uint64_t> &value, std::uint64_t n) {
+  if (value.load(std::memory_order_relaxed) < n)
+    value.store(n, std::memory_order_relaxed);
+}
+
+std::size_t bucket_of(std::uint64_t ns) {
+  std::size_t bits = ns ? 64 - __builtin_clzll(ns) : 0;
+  return std::min(bits, TimerStats::kBuckets - 1);
+}
+
+} // namespace
+
+const char *timer_name(Timer timer) { return kTimerNames[std::size_t(timer)]; }
+const char *counter_name(Counter counter) { return kCounterNames[std::size_t(counter)]; }
+
+std::uint64_t TimerStats::quantile_ns(double q) const {
+  if (count == 0)
+    return 0;
+  std::uint64_t rank = std::uint64_t(q * double(count - 1)) + 1;
+  std::uint64_t seen = 0;
+  for (std::size_t b = 0; b < kBuckets; ++b) {
+    seen += buckets[b];
+    if (seen >= rank)
+      return std::min(max_ns, b ? (std::uint64_t(1) << b) - 1 : 0);
+  }
+  return max_ns;
+}
+
+struct alignas(64) Metrics::Block {
+  struct TimerBlock {
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> total_ns{0};
+    std::atomic<std::uint64_t> max_ns{0};
+    std::atomic<std::uint64_t> buckets[TimerStats::kBuckets] = {};
+  };
+
+  std::atomic<std::uint64_t> counters[std::size_t(Counter::Count)] = {};
+  TimerBlock timers[std::size_t(Timer::Count)];
+};
+
+Metrics::Metrics() : instance(next_instance++) {}
+
+Metrics::~Metrics() = default;
+
+Metrics::Block &Metrics::local_block() {
+  // Блоки текущего потока по экземплярам, как у колец AsyncLogger: пара
+  // (поток, Metrics) регистрирует ровно один блок
+  thread_local std::vector<std::pair<std::uint64_t, Block *>> cached;
+  for (auto &[id, block] : cached) {
+    if (id == instance)
+      return *block;
+  }
+  Block *block;
+  {
+    std::lock_guard lock(blocks_mutex);
+    blocks.push_back(std::make_unique<Block>());
+    block = blocks.back().get();
+  }
+  cached.emplace_back(instance, block);
+  return *block;
+}
+
+void Metrics::add(Counter counter, std::uint64_t n) {
+  bump(local_block().counters[std::size_t(counter)], n);
+}
+
+void Metrics::record(Timer timer, std::chrono::nanoseconds duration) {
+  std::uint64_t ns = std::uint64_t(std::max<std::int64_t>(0, duration.count()));
+  auto &t = local_block().timers[std::size_t(timer)];
+  bump(t.count, 1);
+  bump(t.total_ns, ns);
+  raise(t.max_ns, ns);
+  bump(t.buckets[bucket_of(ns)], 1);
+}
+
+std::size_t Metrics::block_count() const {
+  std::lock_guard lock(blocks_mutex);
+  return blocks.size();
+}
+
+MetricsSnapshot Metrics::snapshot() const {
+  MetricsSnapshot s;
+  std::lock_guard lock(blocks_mutex);
+  for (const auto &block : blocks) {
+    for (std::size_t c = 0; c < s.counters.size(); ++c)
+      s.counters[c] += block->counters[c].load(std::memory_order_relaxed);
+    for (std::size_t t = 0; t < s.timers.size(); ++t) {
+      const auto &from = block->timers[t];
+      TimerStats &to = s.timers[t];
+      to.count += from.count.load(std::memory_order_relaxed);
+      to.total_ns += from.total_ns.load(std::memory_order_relaxed);
+      to.max_ns = std::max(to.max_ns, from.max_ns.load(std::memory_order_relaxed));
+      for (std::size_t b = 0; b < TimerStats::kBuckets; ++b)
+        to.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+    }
+  }
+  return s;
+}
+
+void write_metrics_json(std::ostream &os, const MetricsSnapshot &s, std::uint64_t tick) {
+  os << "{\"tick\":" << tick << ",\"counters\":{";
+  for (std::size_t c = 0; c < s.counters.size(); ++c)
+    os << (c ? "," : "") << '"' << kCounterNames[c] << "\":" << s.counters[c];
+  os << "},\"timers\":{";
+  for (std::size_t t = 0; t < s.timers.size(); ++t) {
+    const TimerStats &timer = s.timers[t];
+    os << (t ? "," : "") << '"' << kTimerNames[t] << "\":{\"count\":" << timer.count
+       << ",\"total_us\":" << timer.total_ns / 1000 << ",\"p50_us\":" << timer.quantile_ns(0.5) / 1000
+       << ",\"p99_us\":" << timer.quantile_ns(0.99) / 1000 << ",\"max_us\":" << timer.max_ns / 1000
+       << '}';
+  }
+  os << "}}\n";
+}
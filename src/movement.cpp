@@ -0,0 +1,146 @@
+#include "../include/movement.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+
+namespace {
+
+std::uint64_t splitmix64(std::uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Номер потока случайных чисел для шагов NPC
+constexpr std::uint64_t kMoveStream = ~std::uint64_t(0) - 2;
+
+} // namespace
+
+std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t tick, std::uint64_t stream) {
+  return splitmix64(splitmix64(splitmix64(seed) ^ tick) ^ stream);
+}
+
+std::uint64_t move_stream(std::uint64_t seed, std::uint64_t tick) {
+  return stream_seed(seed, tick, kMoveStream);
+}
+
+void move_direction(std::uint64_t stream, entity_id id, int &dx, int &dy) {
+  std::uint64_t bits = splitmix64(stream ^ id);
+  dx = int((bits & 0xFFFFFFFFu) % 3) - 1;
+  dy = int((bits >> 32) % 3) - 1;
+}
+
+void merge_candidate_runs(std::vector<FightCandidate> &candidates, const std::vector<std::size_t> &bounds) {
+  auto by_pair = [](const FightCandidate &a, const FightCandidate &b) {
+    return a.attacker != b.attacker ? a.attacker < b.attacker : a.defender < b.defender;
+  };
+  for (std::size_t width = 1; width + 1 < bounds.size(); width *= 2) {
+    for (std::size_t k = 0; k + width + 1 < bounds.size(); k += 2 * width) {
+      std::size_t last = std::min(k + 2 * width, bounds.size() - 1);
+      std::inplace_merge(candidates.begin() + bounds[k], candidates.begin() + bounds[k + width],
+                         candidates.begin() + bounds[last], by_pair);
+    }
+  }
+}
+
+MovementSystem::MovementSystem(World &_world, int _max_x, int _max_y, std::uint64_t _seed,
+                               ThreadPool *_pool, int tile_size)
+    : world(_world), max_x(_max_x), max_y(_max_y), seed(_seed), pool(_pool),
+      tiles(_max_x, _max_y, tile_size, _world.max_kill_distance()) {}
+
+void MovementSystem::run(std::size_t tasks, const ThreadPool::Job &job) {
+  if (pool) {
+    pool->parallel_for(tasks, job);
+    return;
+  }
+  for (std::size_t t = 0; t < tasks; ++t)
+    job(t, 0);
+}
+
+const std::vector<FightCandidate> &MovementSystem::tick() {
+  // Погибшие на прошлом тике выпадают из обхода
+  world.compact();
+  const auto &active = world.active_ids();
+  std::size_t chunks = chunk_count();
+
+  // Движение NPC
+  {
+    Metrics::Scope scope(metrics, Timer::Move);
+    TRACE_SCOPE("move");
+    std::uint64_t stream = move_stream(seed, tick_index);
+    run(chunks, [&](std::size_t chunk, std::size_t) {
+      TRACE_SCOPE("move chunk");
+      std::size_t end = std::min(active.size(), (chunk + 1) * kChunkSize);
+      for (std::size_t k = chunk * kChunkSize; k < end; ++k) {
+        entity_id i = active[k];
+        if (world.scripted[i]) continue;
+
+        int move_dist = world.move_distance[i];
+        int dx, dy;
+        move_direction(stream, i, dx, dy);
+        world.move(i, dx * move_dist, dy * move_dist, max_x, max_y);
+      }
+    });
+  }
+
+  // Проверка на возможность боя - только соседние ячейки
+  {
+    Metrics::Scope scope(metrics, Timer::Detect);
+    TRACE_SCOPE("detect");
+    {
+      // Раскладка по тайлам и обмен гостями: сетки строятся заново каждый
+      // тик, тайлы независимы и строятся параллельно
+      TRACE_SCOPE("tiles");
+      tiles.assign(world);
+      run(tiles.tile_count(), [&](std::size_t tile, std::size_t) { tiles.build(tile, world); });
+    }
+
+    detect_tasks.clear();
+    for (std::size_t tile = 0; tile < tiles.tile_count(); ++tile) {
+      for (std::size_t begin = 0; begin < tiles.owned(tile).size(); begin += kChunkSize)
+        detect_tasks.push_back({tile, begin});
+    }
+    task_candidates.resize(detect_tasks.size());
+
+    run(detect_tasks.size(), [&](std::size_t task, std::size_t) {
+      TRACE_SCOPE("detect chunk");
+      const DetectTask &work = detect_tasks[task];
+      const auto &owned = tiles.owned(work.tile);
+      auto &out = task_candidates[task];
+      out.clear();
+      std::size_t tested = 0;
+      std::size_t end = std::min(owned.size(), work.begin + kChunkSize);
+      for (std::size_t k = work.begin; k < end; ++k) {
+        entity_id i = owned[k];
+        std::size_t first = out.size();
+        // В сетке только живые: мёртвых отсеял assign
+        tested += tiles.for_each_within(work.tile, world.x[i], world.y[i], world.kill_distance[i],
+                                        [&](std::size_t j) {
+                                          if (i != j)
+                                            out.push_back({i, entity_id(j)});
+                                        });
+        // Порядок обхода ячеек зависит от раскладки сетки, порядок боёв - нет
+        std::sort(out.begin() + first, out.end(),
+                  [](const FightCandidate &a, const FightCandidate &b) { return a.defender < b.defender; });
+      }
+      if (metrics)
+        metrics->add(Counter::PairsTested, tested);
+    });
+
+    // Свои NPC тайла идут по возрастанию id, поэтому кандидаты каждого тайла
+    // уже упорядочены; остаётся слить тайлы попарно
+    candidates.clear();
+    tile_bounds.assign(1, 0);
+    for (std::size_t task = 0; task < detect_tasks.size(); ++task) {
+      if (task > 0 && detect_tasks[task].tile != detect_tasks[task - 1].tile)
+        tile_bounds.push_back(candidates.size());
+      candidates.insert(candidates.end(), task_candidates[task].begin(), task_candidates[task].end());
+    }
+    tile_bounds.push_back(candidates.size());
+    merge_candidate_runs(candidates, tile_bounds);
+  }
+
+  ++tick_index;
+  return candidates;
+}
@@ -1,41 +1,82 @@
 #include "../include/npc.hpp"
+#include "../include/world.hpp"
+
+NPC::NPC(World &_world, std::uint32_t _id) : world(&_world), id(_id) {}
 
 NPC::NPC(NpcType t, int _x, int _y, const std::string &_name)
-    : type(t), x(_x), y(_y), name(_name), alive(true) {}
+    : own_world(std::make_unique<World>()) {
+  world = own_world.get();
+  id = world->spawn(t, _x, _y, _name);
+}
 
-NPC::NPC(NpcType t, std::istream &is) : type(t), alive(true) {
-  is >> x >> y;
+NPC::NPC(NpcType t, std::istream &is) : own_world(std::make_unique<World>()) {
+  int _x, _y;
+  std::string _name;
+  is >> _x >> _y;
   is.ignore();
-  std::getline(is, name);
+  std::getline(is, _name);
+  world = own_world.get();
+  id = world->spawn(t, _x, _y, _name);
 }
 
+NPC::~NPC() = default;
+
 void NPC::subscribe(std::shared_ptr<IFightObserver> observer) {
   observers.push_back(observer);
 }
 
 void NPC::fight_notify(const std::shared_ptr<NPC> defender, bool win) {
+  world->events.post(id, defender->id, get_type(), defender->get_type(), win);
+  if (observers.empty())
+    return;
+
+  auto self = shared_from_this();
   for (auto &o : observers)
-    o->on_fight(shared_from_this(), defender, win);
+    o->on_fight(self, defender, win);
 }
 
 bool NPC::is_close(const std::shared_ptr<NPC> &other, size_t distance) const {
-  std::shared_lock lock1(mutex);
-  std::shared_lock lock2(other->mutex);
-  
-  int dx = x - other->x;
-  int dy = y - other->y;
-  return (dx * dx + dy * dy) <= (int)(distance * distance);
+  if (world == other->world)
+    return world->is_close(id, other->id, (int)distance);
+
+  std::int64_t dx = std::int64_t(get_x()) - other->get_x();
+  std::int64_t dy = std::int64_t(get_y()) - other->get_y();
+  return dx * dx + dy * dy <= std::int64_t(distance) * std::int64_t(distance);
+}
+
+NpcType NPC::get_type() const { return world->type[id]; }
+
+int NPC::get_move_distance() const { return world->move_distance[id]; }
+
+int NPC::get_kill_distance() const { return world->kill_distance[id]; }
+
+int NPC::get_x() const { return world->x[id]; }
+
+int NPC::get_y() const { return world->y[id]; }
+
+std::string NPC::get_name() const { return std::string(world->name(id)); }
+
+bool NPC::is_alive() const { return world->alive[id]; }
+
+void NPC::set_alive(bool status) {
+  if (status)
+    world->revive(id);
+  else
+    world->kill(id);
+}
+
+void NPC::move(int dx, int dy, int max_x, int max_y) {
+  world->move(id, dx, dy, max_x, max_y);
 }
 
 void NPC::save(std::ostream &os) {
-  std::shared_lock lock(mutex);
-  os << x << std::endl;
-  os << y << std::endl;
-  os << name << std::endl;
+  os << world->x[id] << '\n';
+  os << world->y[id] << '\n';
+  os << world->name(id) << '\n';
 }
 
 std::ostream &operator << (std::ostream & os, NPC &npc) {
-  std::shared_lock lock(npc.mutex);
-  os << "{ x:" << npc.x << ", y:" << npc.y << ", name: " << npc.name << " }";
+  os << "{ x:" << npc.world->x[npc.id] << ", y:" << npc.world->y[npc.id]
+     << ", name: " << npc.world->name(npc.id) << " }";
   return os;
-}
\ No newline at end of file
+}
@@ -1,16 +1,19 @@
 #include "../include/dragon.hpp"
 #include "../include/knight.hpp"
 #include "../include/pegasus.hpp"
+#include "../include/rules.hpp"
 
 Pegasus::Pegasus(int x, int y, const std::string &name)
     : NPC(PegasusType, x, y, name) {}
 
 Pegasus::Pegasus(std::istream &is) : NPC(PegasusType, is) {}
 
+Pegasus::Pegasus(World &world, std::uint32_t id) : NPC(world, id) {}
+
 void Pegasus::print() { std::cout << *this; }
 
 void Pegasus::save(std::ostream &os) {
-  os << PegasusType << std::endl;
+  os << PegasusType << '\n';
   NPC::save(os);
 }
 
@@ -23,18 +26,21 @@ bool Pegasus::accept(std::shared_ptr<NPC> attacker) {
 }
 
 bool Pegasus::visit(Knight &other) {
-  fight_notify(other.shared_from_this(), false);
-  return false;
+  bool win = can_kill(PegasusType, KnightType);
+  fight_notify(other.shared_from_this(), win);
+  return win;
 }
 
 bool Pegasus::visit(Dragon &other) {
-  fight_notify(other.shared_from_this(), false);
-  return false;
+  bool win = can_kill(PegasusType, DragonType);
+  fight_notify(other.shared_from_this(), win);
+  return win;
 }
 
 bool Pegasus::visit(Pegasus &other) {
-  fight_notify(other.shared_from_this(), false);
-  return false;
+  bool win = can_kill(PegasusType, PegasusType);
+  fight_notify(other.shared_from_this(), win);
+  return win;
 }
 
 std::ostream &operator<<(std::ostream &os, Pegasus &pegasus) {
@@ -0,0 +1,146 @@
+#include "../include/render.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace {
+
+// Градации плотности от пустой ячейки к самой населённой
+constexpr char kRamp[] = " .:-=+*#%@";
+constexpr int kRampSteps = sizeof(kRamp) - 2;
+
+void append_int(std::string &out, long long value) {
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+}
+
+void append_position(std::string &out, int x, int y) {
+  out += '(';
+  append_int(out, x);
+  out += ", ";
+  append_int(out, y);
+  out += ')';
+}
+
+} // namespace
+
+MapRenderer::MapRenderer(RenderMode _mode, int _max_x, int _max_y, int _columns, int _rows)
+    : mode(_mode), max_x(std::max(0, _max_x)), max_y(std::max(0, _max_y)),
+      columns(std::max(1, _columns)), rows(std::max(1, _rows)) {}
+
+void MapRenderer::render(const WorldFrame &frame, const World &world, std::string &out) {
+  switch (mode) {
+  case RenderMode::List:
+    render_list(frame, world, out);
+    break;
+  case RenderMode::Density:
+    render_density(frame, out);
+    break;
+  case RenderMode::Diff:
+    render_diff(frame, world, out);
+    break;
+  }
+}
+
+void MapRenderer::render_list(const WorldFrame &frame, const World &world, std::string &out) {
+  for (entity_id i : frame.active) {
+    out += world.name(i);
+    out += " at ";
+    append_position(out, frame.x[i], frame.y[i]);
+    out += '\n';
+  }
+}
+
+void MapRenderer::render_density(const WorldFrame &frame, std::string &out) {
+  density.assign(std::size_t(columns) * rows, 0);
+  for (entity_id i : frame.active) {
+    int cx = std::clamp(int(std::int64_t(frame.x[i]) * columns / (max_x + 1)), 0, columns - 1);
+    int cy = std::clamp(int(std::int64_t(frame.y[i]) * rows / (max_y + 1)), 0, rows - 1);
+    ++density[std::size_t(cy) * columns + cx];
+  }
+  std::uint32_t peak = *std::max_element(density.begin(), density.end());
+
+  out += "Density ";
+  append_int(out, columns);
+  out += 'x';
+  append_int(out, rows);
+  out += ", up to ";
+  append_int(out, peak);
+  out += " per cell\n";
+
+  std::string border = '+' + std::string(columns, '-') + "+\n";
+  out += border;
+  for (int cy = 0; cy < rows; ++cy) {
+    out += '|';
+    for (int cx = 0; cx < columns; ++cx) {
+      // Одиночка - всегда '.', самая населённая ячейка - всегда '@'
+      std::uint32_t count = density[std::size_t(cy) * columns + cx];
+      std::size_t step = 0;
+      if (count)
+        step = peak > 1 ? 1 + std::uint64_t(count - 1) * (kRampSteps - 1) / (peak - 1) : 1;
+      out += kRamp[step];
+    }
+    out += "|\n";
+  }
+  out += border;
+}
+
+void MapRenderer::render_diff(const WorldFrame &frame, const World &world, std::string &out) {
+  if (!has_previous) {
+    out += "Diff baseline: ";
+    append_int(out, frame.alive_count);
+    out += " alive\n";
+  } else {
+    std::size_t changed = 0;
+    for (entity_id i = 0; i < frame.size(); ++i) {
+      bool was_alive = i < prev_alive.size() && prev_alive[i];
+      bool alive = frame.alive[i];
+      // Слот, занятый заново между кадрами, - это рождение; имя прежнего
+      // владельца к этому моменту уже перезаписано
+      bool reused = was_alive && alive && frame.generation[i] != prev_generation[i];
+      if (alive && (!was_alive || reused)) {
+        out += "+ ";
+        out += world.name(i);
+        out += " at ";
+        append_position(out, frame.x[i], frame.y[i]);
+      } else if (!alive && was_alive) {
+        out += "- ";
+        out += world.name(i);
+      } else if (alive && (frame.x[i] != prev_x[i] || frame.y[i] != prev_y[i])) {
+        out += "~ ";
+        out += world.name(i);
+        out += ' ';
+        append_position(out, prev_x[i], prev_y[i]);
+        out += " -> ";
+        append_position(out, frame.x[i], frame.y[i]);
+      } else {
+        continue;
+      }
+      out += '\n';
+      ++changed;
+    }
+    out += "Changed: ";
+    append_int(out, changed);
+    out += '\n';
+  }
+
+  prev_x.assign(frame.x.begin(), frame.x.end());
+  prev_y.assign(frame.y.begin(), frame.y.end());
+  prev_alive.assign(frame.alive.begin(), frame.alive.end());
+  prev_generation.assign(frame.generation.begin(), frame.generation.end());
+  has_previous = true;
+}
+
+bool parse_render_mode(const std::string &name, RenderMode &mode) {
+  if (name == "list") {
+    mode = RenderMode::List;
+  } else if (name == "density") {
+    mode = RenderMode::Density;
+  } else if (name == "diff") {
+    mode = RenderMode::Diff;
+  } else {
+    return false;
+  }
+  return true;
+}
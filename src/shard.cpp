@@ -0,0 +1,384 @@
+#include "../include/shard.hpp"
+#include "../include/grid.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+enum MessageType : std::uint32_t {
+  kTick = 1,       // координатор -> шард: номер тика и погибшие на прошлом
+  kBorder = 2,     // шард -> координатор: свои NPC у границы и ушедшие за неё
+  kInbox = 3,      // координатор -> шард: пришедшие NPC, затем гости
+  kCandidates = 4, // шард -> координатор: пары для боёв
+  kCollect = 5,    // координатор -> шард: запрос позиций
+  kPositions = 6,  // шард -> координатор: позиции своих NPC
+  kShutdown = 7,
+};
+
+struct MessageHeader {
+  std::uint32_t type;
+  std::uint32_t count; // записей в теле
+  std::uint32_t owned; // kInbox: первые owned записей - NPC, перешедшие в шард
+  std::uint32_t bytes; // размер тела
+  std::uint64_t tick;
+};
+
+struct EntityRecord {
+  entity_id id;
+  std::int32_t x;
+  std::int32_t y;
+};
+
+void send_all(int fd, iovec *parts, int count) {
+  while (count > 0) {
+    msghdr message{};
+    message.msg_iov = parts;
+    message.msg_iovlen = count;
+    // MSG_NOSIGNAL: упавший собеседник - исключение, а не SIGPIPE
+    ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error("shard socket write failed");
+    }
+    while (count > 0 && std::size_t(n) >= parts->iov_len) {
+      n -= ssize_t(parts->iov_len);
+      ++parts;
+      --count;
+    }
+    if (count > 0) {
+      parts->iov_base = static_cast<char *>(parts->iov_base) + n;
+      parts->iov_len -= std::size_t(n);
+    }
+  }
+}
+
+void receive_all(int fd, void *data, std::size_t size) {
+  char *out = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t n = recv(fd, out, size, 0);
+    if (n == 0)
+      throw std::runtime_error("shard peer disconnected");
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error("shard socket read failed");
+    }
+    out += n;
+    size -= std::size_t(n);
+  }
+}
+
+// Заголовок и тело уходят одним sendmsg; возвращает число байт
+template <class T>
+std::size_t send_message(int fd, std::uint32_t type, std::uint64_t tick, const std::vector<T> &records,
+                         std::uint32_t owned = 0) {
+  MessageHeader header{type, std::uint32_t(records.size()), owned,
+                       std::uint32_t(records.size() * sizeof(T)), tick};
+  iovec parts[2] = {{&header, sizeof(header)},
+                    {const_cast<T *>(records.data()), records.size() * sizeof(T)}};
+  send_all(fd, parts, records.empty() ? 1 : 2);
+  return sizeof(header) + header.bytes;
+}
+
+MessageHeader receive_header(int fd) {
+  MessageHeader header;
+  receive_all(fd, &header, sizeof(header));
+  return header;
+}
+
+template <class T> void receive_body(int fd, const MessageHeader &header, std::vector<T> &records) {
+  if (header.bytes != header.count * sizeof(T))
+    throw std::runtime_error("shard message has wrong size");
+  records.resize(header.count);
+  receive_all(fd, records.data(), header.bytes);
+}
+
+template <class T>
+MessageHeader receive_message(int fd, std::uint32_t type, std::vector<T> &records) {
+  MessageHeader header = receive_header(fd);
+  if (header.type != type)
+    throw std::runtime_error("unexpected shard message " + std::to_string(header.type));
+  receive_body(fd, header, records);
+  return header;
+}
+
+// Полосы карты по x: [index * width, (index + 1) * width)
+struct Strips {
+  int width;
+  std::size_t count;
+
+  std::size_t owner(int x) const { return std::min(count - 1, std::size_t(std::max(0, x) / width)); }
+  std::int64_t begin(std::size_t index) const { return std::int64_t(index) * width; }
+  std::int64_t end(std::size_t index) const { return begin(index) + width - 1; }
+
+  // До полосы index не дальше halo
+  bool near(std::size_t index, int x, int halo) const {
+    if (x < begin(index))
+      return begin(index) - x <= halo;
+    return x - end(index) <= halo;
+  }
+};
+
+// Рабочий процесс: ведёт NPC своей полосы
+class ShardWorker {
+public:
+  ShardWorker(World &_world, int _fd, std::size_t _index, Strips _strips, int _max_x, int _max_y,
+              std::uint64_t _seed, int _halo)
+      : world(_world), fd(_fd), index(_index), strips(_strips), max_x(_max_x), max_y(_max_y),
+        seed(_seed), halo(_halo),
+        grid(std::max(1, halo), int(std::min<std::int64_t>(max_x, strips.end(index) + halo)), max_y,
+             int(std::max<std::int64_t>(0, strips.begin(index) - halo)), 0) {
+    for (entity_id i = 0; i < world.size(); ++i) {
+      if (world.alive[i] && strips.owner(world.x[i]) == index)
+        owned.push_back(i);
+    }
+  }
+
+  void run() {
+    for (;;) {
+      MessageHeader header = receive_header(fd);
+      switch (header.type) {
+      case kTick:
+        receive_body(fd, header, deaths);
+        tick(header.tick);
+        break;
+      case kCollect: {
+        std::vector<EntityRecord> positions;
+        positions.reserve(owned.size() + fallen.size());
+        for (entity_id i : owned)
+          positions.push_back({i, world.x[i], world.y[i]});
+        for (entity_id i : fallen)
+          positions.push_back({i, world.x[i], world.y[i]});
+        fallen.clear();
+        send_message(fd, kPositions, header.tick, positions);
+        break;
+      }
+      case kShutdown:
+        return;
+      default:
+        throw std::runtime_error("unexpected shard message " + std::to_string(header.type));
+      }
+    }
+  }
+
+private:
+  World &world;
+  int fd;
+  std::size_t index;
+  Strips strips;
+  int max_x;
+  int max_y;
+  std::uint64_t seed;
+  int halo;
+  SpatialGrid grid;
+
+  // Свои NPC по возрастанию id и гости этого тика
+  std::vector<entity_id> owned;
+  std::vector<entity_id> guests;
+  // Погибшие свои с прошлого сбора: в мире остаются там, где пали
+  std::vector<entity_id> fallen;
+  std::vector<entity_id> deaths;
+  std::vector<EntityRecord> records;
+  std::vector<FightCandidate> out;
+
+  void tick(std::uint64_t tick_index) {
+    for (entity_id id : deaths)
+      world.kill(id);
+    auto dead = std::stable_partition(owned.begin(), owned.end(), [&](entity_id i) { return world.alive[i]; });
+    fallen.insert(fallen.end(), dead, owned.end());
+    owned.erase(dead, owned.end());
+
+    // Движение - тот же шаг, что в MovementSystem
+    std::uint64_t stream = move_stream(seed, tick_index);
+    for (entity_id i : owned) {
+      int move_dist = world.move_distance[i];
+      int dx, dy;
+      move_direction(stream, i, dx, dy);
+      world.move(i, dx * move_dist, dy * move_dist, max_x, max_y);
+    }
+
+    // Ушедшие из полосы и стоящие у её краёв - координатору на раздачу
+    records.clear();
+    for (entity_id i : owned) {
+      int x = world.x[i];
+      if (strips.owner(x) != index || x - strips.begin(index) < halo || strips.end(index) - x < halo)
+        records.push_back({i, x, world.y[i]});
+    }
+    send_message(fd, kBorder, tick_index, records);
+    owned.erase(std::remove_if(owned.begin(), owned.end(),
+                               [&](entity_id i) { return strips.owner(world.x[i]) != index; }),
+                owned.end());
+
+    MessageHeader inbox = receive_message(fd, kInbox, records);
+    guests.clear();
+    for (std::size_t k = 0; k < records.size(); ++k) {
+      const EntityRecord &record = records[k];
+      world.x[record.id] = record.x;
+      world.y[record.id] = record.y;
+      (k < inbox.owned ? owned : guests).push_back(record.id);
+    }
+    std::sort(owned.begin(), owned.end());
+
+    // Поиск пар, как в MovementSystem: свои против своих и гостей
+    grid.clear();
+    for (entity_id i : owned)
+      grid.insert(i, world.x[i], world.y[i]);
+    for (entity_id i : guests)
+      grid.insert(i, world.x[i], world.y[i]);
+
+    out.clear();
+    for (entity_id i : owned) {
+      std::size_t first = out.size();
+      grid.for_each_within(world.x[i], world.y[i], world.kill_distance[i], [&](std::size_t j) {
+        if (i != j)
+          out.push_back({i, entity_id(j)});
+      });
+      std::sort(out.begin() + first, out.end(),
+                [](const FightCandidate &a, const FightCandidate &b) { return a.defender < b.defender; });
+    }
+    send_message(fd, kCandidates, tick_index, out);
+  }
+};
+
+} // namespace
+
+ShardCoordinator::ShardCoordinator(World &_world, std::vector<std::shared_ptr<NPC>> &_npcs,
+                                   const SimulationConfig &config, std::size_t shards)
+    : world(_world), npcs(_npcs), seed(config.seed), halo(std::max(0, _world.max_kill_distance())) {
+  // Гости ходят только в соседние полосы, поэтому полоса не уже halo
+  std::int64_t columns = std::int64_t(config.max_x) + 1;
+  shards = std::max<std::size_t>(1, std::min<std::size_t>(shards, columns / std::max(1, halo)));
+  strip_width = int((columns + std::int64_t(shards) - 1) / std::int64_t(shards));
+  Strips strips{strip_width, shards};
+
+  for (std::size_t index = 0; index < shards; ++index) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      shutdown();
+      throw std::runtime_error("cannot create shard socket");
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      shutdown();
+      throw std::runtime_error("cannot fork shard worker");
+    }
+    if (pid == 0) {
+      // Рабочий процесс: только свой сокет, выход без деструкторов родителя
+      close(fds[0]);
+      for (const auto &worker : workers)
+        close(worker.fd);
+      int status = 0;
+      try {
+        TRACE_THREAD_NAME("shard");
+        ShardWorker(world, fds[1], index, strips, config.max_x, config.max_y, seed, halo).run();
+      } catch (...) {
+        status = 1;
+      }
+      _exit(status);
+    }
+    close(fds[1]);
+    workers.push_back({pid, fds[0]});
+  }
+}
+
+ShardCoordinator::~ShardCoordinator() { shutdown(); }
+
+void ShardCoordinator::shutdown() {
+  std::vector<int> none;
+  for (const auto &worker : workers) {
+    try {
+      send_message(worker.fd, kShutdown, tick, none);
+    } catch (const std::exception &) {
+      // Рабочий уже вышел - остаётся только дождаться его
+    }
+    close(worker.fd);
+    waitpid(worker.pid, nullptr, 0);
+  }
+  workers.clear();
+}
+
+std::size_t ShardCoordinator::step() {
+  TRACE_SCOPE("tick");
+  world.events.set_tick(tick);
+  Strips strips{strip_width, workers.size()};
+
+  for (const auto &worker : workers)
+    totals.bytes_sent += send_message(worker.fd, kTick, tick, deaths);
+  deaths.clear();
+
+  // Раздача через границы: ушедший NPC - новому хозяину, NPC у края -
+  // гостем в соседние полосы
+  std::vector<std::vector<EntityRecord>> arrived(workers.size()), guests(workers.size());
+  std::vector<EntityRecord> records;
+  for (std::size_t index = 0; index < workers.size(); ++index) {
+    MessageHeader header = receive_message(workers[index].fd, kBorder, records);
+    totals.bytes_received += sizeof(header) + header.bytes;
+    for (const auto &record : records) {
+      std::size_t owner = strips.owner(record.x);
+      if (owner != index) {
+        arrived[owner].push_back(record);
+        ++totals.migrated;
+      }
+      for (std::size_t next : {owner - 1, owner + 1}) {
+        if (next < workers.size() && strips.near(next, record.x, halo)) {
+          guests[next].push_back(record);
+          ++totals.guests;
+        }
+      }
+    }
+  }
+  for (std::size_t index = 0; index < workers.size(); ++index) {
+    auto &inbox = arrived[index];
+    std::uint32_t owned = std::uint32_t(inbox.size());
+    inbox.insert(inbox.end(), guests[index].begin(), guests[index].end());
+    totals.bytes_sent += send_message(workers[index].fd, kInbox, tick, inbox, owned);
+  }
+
+  // Атакующие у шардов не пересекаются: кандидаты сливаются по порядку
+  candidates.clear();
+  std::vector<std::size_t> bounds{0};
+  std::vector<FightCandidate> part;
+  for (const auto &worker : workers) {
+    MessageHeader header = receive_message(worker.fd, kCandidates, part);
+    totals.bytes_received += sizeof(header) + header.bytes;
+    candidates.insert(candidates.end(), part.begin(), part.end());
+    bounds.push_back(candidates.size());
+  }
+  merge_candidate_runs(candidates, bounds);
+
+  combat.build(candidates);
+  std::size_t kills = combat.resolve(world, npcs, seed, tick, nullptr, metrics, &deaths);
+  {
+    Metrics::Scope scope(metrics, Timer::Notify);
+    TRACE_SCOPE("notify");
+    world.events.dispatch();
+  }
+  ++tick;
+  return kills;
+}
+
+void ShardCoordinator::collect() {
+  std::vector<int> none;
+  std::vector<EntityRecord> positions;
+  for (const auto &worker : workers) {
+    totals.bytes_sent += send_message(worker.fd, kCollect, tick, none);
+    MessageHeader header = receive_message(worker.fd, kPositions, positions);
+    totals.bytes_received += sizeof(header) + header.bytes;
+    for (const auto &record : positions) {
+      world.x[record.id] = record.x;
+      world.y[record.id] = record.y;
+    }
+  }
+}
@@ -0,0 +1,172 @@
+#include "../include/simulation.hpp"
+#include "../include/dragon.hpp"
+#include "../include/knight.hpp"
+#include "../include/pegasus.hpp"
+#include "../include/trace.hpp"
+
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+
+// Номер потока случайных чисел расстановки, рядом с потоками движения и боёв
+constexpr std::uint64_t kSpawnStream = ~std::uint64_t(0);
+
+// То же, что generate_name, но в готовую строку без выделений
+void format_name(NpcType type, std::size_t index, std::string &out) {
+  static constexpr std::string_view prefixes[] = {"Unknown_", "Knight_", "Dragon_", "Pegasus_"};
+  out.assign(prefixes[type < std::size(prefixes) ? type : 0]);
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), index);
+  out.append(digits, result.ptr);
+}
+
+} // namespace
+
+std::shared_ptr<NPC> make_handle(World &world, entity_id id) {
+  // Ручка и блок управления shared_ptr ложатся в один блок пула мира
+  const auto &pool = world.handle_pool();
+  switch (world.type[id]) {
+  case KnightType:
+    return std::allocate_shared<Knight>(SlabAllocator<Knight>(pool), world, id);
+  case DragonType:
+    return std::allocate_shared<Dragon>(SlabAllocator<Dragon>(pool), world, id);
+  case PegasusType:
+    return std::allocate_shared<Pegasus>(SlabAllocator<Pegasus>(pool), world, id);
+  default:
+    return nullptr;
+  }
+}
+
+std::shared_ptr<NPC> create_npc(World &world, NpcType type, int x, int y, const std::string &name) {
+  return make_handle(world, world.spawn(type, x, y, name));
+}
+
+std::string generate_name(NpcType type, int index) {
+  switch (type) {
+  case KnightType:
+    return "Knight_" + std::to_string(index);
+  case DragonType:
+    return "Dragon_" + std::to_string(index);
+  case PegasusType:
+    return "Pegasus_" + std::to_string(index);
+  default:
+    return "Unknown_" + std::to_string(index);
+  }
+}
+
+entity_id spawn_population(World &world, std::vector<std::shared_ptr<NPC>> &npcs, const PopulationSpec &spec,
+                           ThreadPool *pool) {
+  std::array<std::uint64_t, std::size(npc_traits)> bounds{};
+  std::uint64_t total = 0;
+  for (std::size_t t = 0; t < bounds.size(); ++t)
+    bounds[t] = total += spec.weights[t];
+  if (total == 0 && spec.count > 0)
+    throw std::runtime_error("population has no NPC types");
+
+  // Равномерно в [0, max] по старшим 32 битам без деления
+  auto uniform = [](std::uint64_t bits, int max) {
+    return int(((bits >> 32) * (std::uint64_t(max) + 1)) >> 32);
+  };
+  entity_id first = world.spawn_bulk(spec.count, pool, [&](std::size_t i, std::string &name) {
+    std::uint64_t bits = stream_seed(spec.seed, i, kSpawnStream);
+    std::uint64_t more = stream_seed(bits, i, kSpawnStream);
+    std::uint64_t pick = bits % total;
+    std::size_t t = 0;
+    while (pick >= bounds[t])
+      ++t;
+    NpcType type = NpcType(t);
+    format_name(type, i, name);
+    return SpawnRecord{type, uniform(bits, spec.max_x), uniform(more, spec.max_y), name};
+  });
+
+  npcs.resize(world.size());
+  for (entity_id id = first; id < world.size(); ++id)
+    npcs[id] = make_handle(world, id);
+  return first;
+}
+
+void populate(World &world, std::vector<std::shared_ptr<NPC>> &npcs, std::size_t count,
+              int max_x, int max_y, std::uint64_t seed, ThreadPool *pool) {
+  spawn_population(world, npcs, {count, max_x, max_y, seed}, pool);
+}
+
+void configure_world(World &world, const SimulationConfig &config) {
+  for (std::size_t t = 0; t < config.traits.size(); ++t)
+    world.set_traits(NpcType(t), config.traits[t]);
+}
+
+std::uint64_t world_hash(const World &world) {
+  // FNV-1a
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  auto mix = [&](std::uint64_t value) {
+    for (int b = 0; b < 8; ++b) {
+      hash ^= (value >> (b * 8)) & 0xFF;
+      hash *= 0x100000001b3ull;
+    }
+  };
+  for (entity_id i = 0; i < world.size(); ++i) {
+    mix(std::uint32_t(world.x[i]));
+    mix(std::uint32_t(world.y[i]));
+    mix(world.alive[i]);
+  }
+  return hash;
+}
+
+Simulation::Simulation(World &_world, std::vector<std::shared_ptr<NPC>> &_npcs,
+                       const SimulationConfig &config, ThreadPool *_pool)
+    : world(_world), npcs(_npcs), seed(config.seed), pool(_pool),
+      movement(_world, config.max_x, config.max_y, config.seed, _pool, config.tile_size) {
+  if (config.behaviors) {
+    behaviors = std::make_unique<BehaviorScheduler>(world, config.max_x, config.max_y, config.seed, pool);
+    attach_default_behaviors(*behaviors, world);
+  }
+  movement.set_tick(config.start_tick);
+  if (!config.checkpoint_dir.empty())
+    checkpoints = std::make_unique<Checkpointer>(world, config.checkpoint_dir, config.checkpoint_every,
+                                                 config.start_tick);
+}
+
+void Simulation::set_metrics(Metrics *_metrics) {
+  metrics = _metrics;
+  movement.set_metrics(_metrics);
+  if (behaviors)
+    behaviors->set_metrics(_metrics);
+  if (checkpoints)
+    checkpoints->set_metrics(_metrics);
+}
+
+std::size_t Simulation::step() {
+  TRACE_SCOPE("tick");
+  std::uint64_t tick = movement.get_tick();
+  world.events.set_tick(tick);
+  if (behaviors)
+    behaviors->run(tick);
+  const auto &candidates = movement.tick();
+  combat.build(candidates);
+  std::size_t kills = combat.resolve(world, npcs, seed, tick, pool, metrics);
+
+  {
+    Metrics::Scope scope(metrics, Timer::Notify);
+    TRACE_SCOPE("notify");
+    world.events.dispatch();
+  }
+  if (checkpoints)
+    checkpoints->commit(get_tick());
+  return kills;
+}
+
+const SpatialIndex &Simulation::spatial() {
+  std::uint64_t tick = get_tick();
+  if (index_ready && index_tick == tick)
+    return index;
+
+  if (!index_ready || tick - index_built >= kIndexRebuildTicks || !index.refit(world)) {
+    TRACE_SCOPE("spatial build");
+    index.build(world);
+    index_built = tick;
+  }
+  index_ready = true;
+  index_tick = tick;
+  return index;
+}
@@ -0,0 +1,46 @@
+#include "../include/slab.hpp"
+
+#include <algorithm>
+
+SlabPool::SlabPool(std::size_t _block_size, std::size_t _blocks_per_slab)
+    : blocks_per_slab(std::max<std::size_t>(1, _blocks_per_slab)) {
+  // Размер блока кратен выравниванию, чтобы любой блок был выровнен
+  const std::size_t align = alignof(std::max_align_t);
+  block_size = (std::max(_block_size, sizeof(FreeNode)) + align - 1) / align * align;
+}
+
+void *SlabPool::allocate() {
+  std::lock_guard lock(mutex);
+  if (!free_list) {
+    // operator new[] выравнивает не хуже max_align_t
+    slabs.emplace_back(new std::byte[block_size * blocks_per_slab]);
+    std::byte *slab = slabs.back().get();
+    for (std::size_t i = blocks_per_slab; i-- > 0;) {
+      auto *node = reinterpret_cast<FreeNode *>(slab + i * block_size);
+      node->next = free_list;
+      free_list = node;
+    }
+  }
+  FreeNode *node = free_list;
+  free_list = node->next;
+  ++used;
+  return node;
+}
+
+void SlabPool::deallocate(void *block) {
+  std::lock_guard lock(mutex);
+  auto *node = static_cast<FreeNode *>(block);
+  node->next = free_list;
+  free_list = node;
+  --used;
+}
+
+std::size_t SlabPool::slab_count() const {
+  std::lock_guard lock(mutex);
+  return slabs.size();
+}
+
+std::size_t SlabPool::in_use() const {
+  std::lock_guard lock(mutex);
+  return used;
+}
@@ -0,0 +1,306 @@
+#include "../include/snapshot.hpp"
+#include "../include/distance.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+bool valid_type(int type) { return type >= KnightType && type <= PegasusType; }
+
+// Ядро дистанций и сетка рассчитаны на координаты в [0, kMaxCoordinate]
+bool valid_coordinate(int value) { return value >= 0 && value <= kMaxCoordinate; }
+
+// Вычитанием: сумма подобранных offset и length может переполниться
+bool name_fits(const SnapshotRecord &record, std::uint64_t strings_size) {
+  return record.name_length <= strings_size && record.name_offset <= strings_size - record.name_length;
+}
+
+SnapshotHeader make_header(std::uint64_t count, std::uint64_t strings_size) {
+  SnapshotHeader header{};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.record_size = sizeof(SnapshotRecord);
+  header.count = count;
+  header.strings_offset = sizeof(SnapshotHeader) + count * sizeof(SnapshotRecord);
+  header.strings_size = strings_size;
+  return header;
+}
+
+// Байт текста на часть импорта: меньшие куски не окупают задачу пула
+constexpr std::size_t kImportChunk = 1 << 20;
+
+// Первая ошибка разбора части, line - номер строки с 1, 0 - ошибок нет
+struct ImportError {
+  std::size_t line = 0;
+  std::string message;
+};
+
+void run_parts(ThreadPool *pool, std::size_t parts, const ThreadPool::Job &job) {
+  if (pool && parts > 1) {
+    pool->parallel_for(parts, job);
+  } else {
+    for (std::size_t p = 0; p < parts; ++p)
+      job(p, 0);
+  }
+}
+
+// Целое во всю строку; пробелы и '\r' по краям допускаются, как у operator>>
+bool parse_int(std::string_view line, int &value) {
+  auto space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+  while (!line.empty() && space(line.front()))
+    line.remove_prefix(1);
+  while (!line.empty() && space(line.back()))
+    line.remove_suffix(1);
+  auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), value);
+  return error == std::errc() && end == line.data() + line.size() && !line.empty();
+}
+
+} // namespace
+
+void save_snapshot(const World &world, std::ostream &os) {
+  std::shared_lock lock(world.get_mutex());
+
+  std::uint64_t strings_size = 0;
+  for (entity_id i = 0; i < world.size(); ++i)
+    strings_size += world.name(i).size();
+
+  SnapshotHeader header = make_header(world.size(), strings_size);
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  const std::size_t block = 4096;
+  std::vector<SnapshotRecord> records;
+  records.reserve(block);
+  std::uint64_t name_offset = 0;
+  for (entity_id i = 0; i < world.size(); ++i) {
+    SnapshotRecord record{};
+    record.x = world.x[i];
+    record.y = world.y[i];
+    record.type = std::uint8_t(world.type[i]);
+    record.alive = world.alive[i];
+    record.name_length = std::uint32_t(world.name(i).size());
+    record.name_offset = name_offset;
+    name_offset += record.name_length;
+    records.push_back(record);
+
+    if (records.size() == block) {
+      os.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(SnapshotRecord));
+      records.clear();
+    }
+  }
+  os.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(SnapshotRecord));
+
+  std::string strings;
+  strings.reserve(block * 16);
+  for (entity_id i = 0; i < world.size(); ++i) {
+    strings += world.name(i);
+    if (strings.size() >= block * 16) {
+      os.write(strings.data(), strings.size());
+      strings.clear();
+    }
+  }
+  os.write(strings.data(), strings.size());
+}
+
+void capture_snapshot(const World &world, SnapshotImage &image) {
+  std::shared_lock lock(world.get_mutex());
+  image.records.resize(world.size());
+  image.strings.clear();
+  for (entity_id i = 0; i < world.size(); ++i) {
+    std::string_view name = world.name(i);
+    SnapshotRecord &record = image.records[i];
+    record = SnapshotRecord{};
+    record.x = world.x[i];
+    record.y = world.y[i];
+    record.type = std::uint8_t(world.type[i]);
+    record.alive = world.alive[i];
+    record.name_length = std::uint32_t(name.size());
+    record.name_offset = image.strings.size();
+    image.strings += name;
+  }
+}
+
+void save_snapshot(const SnapshotImage &image, std::ostream &os) {
+  SnapshotHeader header = make_header(image.records.size(), image.strings.size());
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char *>(image.records.data()), image.records.size() * sizeof(SnapshotRecord));
+  os.write(image.strings.data(), image.strings.size());
+}
+
+void save_snapshot(const World &world, const std::string &path) {
+  std::ofstream os(path, std::ios::binary | std::ios::trunc);
+  if (!os)
+    throw std::runtime_error("cannot open snapshot for writing: " + path);
+  save_snapshot(world, os);
+  if (!os)
+    throw std::runtime_error("failed to write snapshot: " + path);
+}
+
+SnapshotView::SnapshotView(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("cannot open snapshot: " + path);
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(SnapshotHeader)) {
+    ::close(fd);
+    throw std::runtime_error("snapshot is truncated: " + path);
+  }
+
+  length = st.st_size;
+  data = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("cannot map snapshot: " + path);
+
+  header = static_cast<const SnapshotHeader *>(data);
+  bool valid = std::memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) == 0 &&
+               header->version == kSnapshotVersion &&
+               header->record_size == sizeof(SnapshotRecord) &&
+               // Число записей ограничено размером файла до умножения, иначе
+               // подобранный count переполнит произведение
+               header->count <= (length - sizeof(SnapshotHeader)) / sizeof(SnapshotRecord) &&
+               header->strings_offset == sizeof(SnapshotHeader) + header->count * sizeof(SnapshotRecord) &&
+               header->strings_size <= length - header->strings_offset;
+  if (!valid) {
+    ::munmap(data, length);
+    throw std::runtime_error("not a valid snapshot: " + path);
+  }
+
+  const char *base = static_cast<const char *>(data);
+  record_data = reinterpret_cast<const SnapshotRecord *>(base + sizeof(SnapshotHeader));
+  strings = base + header->strings_offset;
+}
+
+SnapshotView::~SnapshotView() { ::munmap(data, length); }
+
+std::string_view SnapshotView::name(std::size_t i) const {
+  const SnapshotRecord &record = record_data[i];
+  if (!name_fits(record, header->strings_size))
+    return {};
+  return std::string_view(strings + record.name_offset, record.name_length);
+}
+
+entity_id SnapshotView::load_into(World &world) const {
+  // Сначала проверяются все записи: на ошибке мир остаётся нетронутым
+  for (std::size_t i = 0; i < size(); ++i) {
+    const SnapshotRecord &record = record_data[i];
+    if (!valid_type(record.type))
+      throw std::runtime_error("snapshot record has unknown NPC type");
+    if (!valid_coordinate(record.x) || !valid_coordinate(record.y))
+      throw std::runtime_error("snapshot record " + std::to_string(i) + " has coordinates out of range");
+    if (!name_fits(record, header->strings_size))
+      throw std::runtime_error("snapshot record " + std::to_string(i) + " has its name out of bounds");
+  }
+
+  // Записи ложатся в новые слоты подряд, мимо кладбища, поэтому i-я
+  // получает id first + i
+  std::lock_guard lock(world.get_mutex());
+  world.reserve(world.size() + size());
+  entity_id first = world.spawn_bulk(size(), nullptr, [&](std::size_t i, std::string &) {
+    const SnapshotRecord &record = record_data[i];
+    return SpawnRecord{NpcType(record.type), record.x, record.y, name(i)};
+  });
+  for (std::size_t i = 0; i < size(); ++i) {
+    if (!record_data[i].alive)
+      world.kill(first + entity_id(i));
+  }
+  return first;
+}
+
+// Мёртвые NPC не выгружаются: в текстовом формате нет флага жизни
+void export_text(const World &world, std::ostream &os) {
+  std::shared_lock lock(world.get_mutex());
+  for (entity_id i = 0; i < world.size(); ++i) {
+    if (!world.alive[i]) continue;
+    os << world.type[i] << '\n' << world.x[i] << '\n' << world.y[i] << '\n' << world.name(i) << '\n';
+  }
+}
+
+std::size_t import_text(World &world, std::string_view text, ThreadPool *pool) {
+  // Части начинаются с начала строки; строки части - те, что в ней начинаются
+  std::size_t parts = pool ? std::clamp<std::size_t>(text.size() / kImportChunk, 1, pool->size() * 4) : 1;
+  std::vector<std::size_t> starts(parts + 1, text.size());
+  starts[0] = 0;
+  for (std::size_t p = 1; p < parts; ++p) {
+    std::size_t at = std::max(starts[p - 1], text.size() * p / parts);
+    std::size_t newline = at == 0 ? 0 : text.find('\n', at - 1);
+    starts[p] = newline == std::string_view::npos ? text.size() : newline + (at != 0);
+  }
+
+  // Последняя строка без перевода строки тоже считается
+  std::vector<std::size_t> lines(parts + 1, 0);
+  auto count_lines = [&](std::size_t p, std::size_t) {
+    const char *begin = text.data() + starts[p];
+    const char *end = text.data() + starts[p + 1];
+    lines[p + 1] = std::size_t(std::count(begin, end, '\n'));
+    if (end == text.data() + text.size() && begin != end && end[-1] != '\n')
+      ++lines[p + 1];
+  };
+  run_parts(pool, parts, count_lines);
+  for (std::size_t p = 0; p < parts; ++p)
+    lines[p + 1] += lines[p];
+  std::size_t total = lines[parts] / 4;
+  if (lines[parts] % 4)
+    throw std::runtime_error("text import line " + std::to_string(lines[parts]) + ": truncated NPC record");
+
+  // Запись разбирает та часть, в которой начинается её первая строка
+  std::vector<SpawnRecord> records(total);
+  std::vector<ImportError> errors(parts);
+  auto parse_part = [&](std::size_t p, std::size_t) {
+    std::size_t line = lines[p];
+    const char *cursor = text.data() + starts[p];
+    const char *text_end = text.data() + text.size();
+    auto next_line = [&] {
+      const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', text_end - cursor));
+      std::string_view result(cursor, (newline ? newline : text_end) - cursor);
+      cursor = newline ? newline + 1 : text_end;
+      ++line;
+      return result;
+    };
+    while (line % 4 && line < lines[p + 1])
+      next_line();
+    while (line < lines[p + 1]) {
+      SpawnRecord &record = records[line / 4];
+      int type = 0;
+      if (!parse_int(next_line(), type) || !parse_int(next_line(), record.x) || !parse_int(next_line(), record.y)) {
+        errors[p] = {line, "expected an integer"};
+        return;
+      }
+      if (!valid_type(type)) {
+        errors[p] = {line - 2, "unknown NPC type in text import: " + std::to_string(type)};
+        return;
+      }
+      if (!valid_coordinate(record.x) || !valid_coordinate(record.y)) {
+        errors[p] = {valid_coordinate(record.x) ? line : line - 1, "coordinate out of range in text import"};
+        return;
+      }
+      record.type = NpcType(type);
+      record.name = next_line();
+    }
+  };
+  run_parts(pool, parts, parse_part);
+  for (const auto &error : errors) {
+    if (error.line)
+      throw std::runtime_error("text import line " + std::to_string(error.line) + ": " + error.message);
+  }
+
+  std::lock_guard lock(world.get_mutex());
+  world.reserve(world.size() + total);
+  world.spawn_bulk(records, pool);
+  return total;
+}
+
+std::size_t import_text(World &world, std::istream &is, ThreadPool *pool) {
+  std::string text(std::istreambuf_iterator<char>(is), {});
+  return import_text(world, text, pool);
+}
@@ -0,0 +1,267 @@
+#include "../include/spatial_index.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// Квадрат расстояния от точки до рамки узла, 0 - точка внутри
+template <class Node> std::int64_t box_distance2(const Node &node, int x, int y) {
+  std::int64_t dx = std::max<std::int64_t>({std::int64_t(node.min_x) - x, 0, std::int64_t(x) - node.max_x});
+  std::int64_t dy = std::max<std::int64_t>({std::int64_t(node.min_y) - y, 0, std::int64_t(y) - node.max_y});
+  return dx * dx + dy * dy;
+}
+
+std::int64_t distance2(int ax, int ay, int bx, int by) {
+  std::int64_t dx = std::int64_t(ax) - bx;
+  std::int64_t dy = std::int64_t(ay) - by;
+  return dx * dx + dy * dy;
+}
+
+// Глубина дерева - log2(n / kLeafSize), в стеке обхода лежат только правые соседи
+constexpr std::size_t kStackDepth = 64;
+
+// Запросов на задачу пула в пачке
+constexpr std::size_t kBatchChunk = 256;
+
+} // namespace
+
+void SpatialIndex::build(const World &world) {
+  points.clear();
+  nodes.clear();
+  for (entity_id id : world.active_ids()) {
+    if (world.alive[id])
+      points.push_back({world.x[id], world.y[id], id, type_bit(world.type[id])});
+  }
+  live = points.size();
+  if (points.empty())
+    return;
+
+  nodes.reserve(2 * (points.size() / kLeafSize + 1));
+  build_node(0, std::uint32_t(points.size()));
+}
+
+std::uint32_t SpatialIndex::build_node(std::uint32_t begin, std::uint32_t end) {
+  std::uint32_t index = std::uint32_t(nodes.size());
+  nodes.emplace_back();
+  Node node{};
+  node.begin = begin;
+  node.end = end;
+  node.right = 0;
+  fit_node(node);
+
+  if (end - begin > kLeafSize) {
+    // Делим по более длинной стороне рамки пополам по числу точек
+    bool by_x = std::int64_t(node.max_x) - node.min_x >= std::int64_t(node.max_y) - node.min_y;
+    std::uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(points.begin() + begin, points.begin() + middle, points.begin() + end,
+                     [by_x](const Point &a, const Point &b) { return by_x ? a.x < b.x : a.y < b.y; });
+    build_node(begin, middle);
+    node.right = build_node(middle, end);
+  }
+  nodes[index] = node;
+  return index;
+}
+
+void SpatialIndex::fit_node(Node &node) const {
+  node.min_x = node.min_y = INT_MAX;
+  node.max_x = node.max_y = INT_MIN;
+  node.types = 0;
+  for (std::uint32_t k = node.begin; k < node.end; ++k) {
+    const Point &p = points[k];
+    if (!p.type) continue;
+    node.min_x = std::min(node.min_x, p.x);
+    node.min_y = std::min(node.min_y, p.y);
+    node.max_x = std::max(node.max_x, p.x);
+    node.max_y = std::max(node.max_y, p.y);
+    node.types |= p.type;
+  }
+}
+
+bool SpatialIndex::refit(const World &world) {
+  live = 0;
+  for (auto &p : points) {
+    // Слот мог освободиться и занят заново: точка становится новым NPC
+    p.type = world.alive[p.id] ? type_bit(world.type[p.id]) : 0;
+    p.x = world.x[p.id];
+    p.y = world.y[p.id];
+    live += p.type != 0;
+  }
+
+  // Потомки лежат после родителя, поэтому обход с конца идёт снизу вверх
+  for (std::size_t i = nodes.size(); i-- > 0;) {
+    Node &node = nodes[i];
+    if (!node.right) {
+      fit_node(node);
+      continue;
+    }
+    const Node &left = nodes[i + 1];
+    const Node &right = nodes[node.right];
+    node.min_x = std::min(left.min_x, right.min_x);
+    node.min_y = std::min(left.min_y, right.min_y);
+    node.max_x = std::max(left.max_x, right.max_x);
+    node.max_y = std::max(left.max_y, right.max_y);
+    node.types = left.types | right.types;
+  }
+  return live == world.alive_count();
+}
+
+void SpatialIndex::within_radius(const RadiusQuery &query, std::vector<entity_id> &out) const {
+  if (nodes.empty() || query.radius < 0)
+    return;
+  const std::int64_t limit = std::int64_t(query.radius) * query.radius;
+  std::uint32_t stack[kStackDepth];
+  std::size_t depth = 0;
+  stack[depth++] = 0;
+  while (depth) {
+    std::uint32_t index = stack[--depth];
+    const Node &node = nodes[index];
+    if (!(node.types & query.types) || box_distance2(node, query.x, query.y) > limit)
+      continue;
+    if (node.right) {
+      stack[depth++] = node.right;
+      stack[depth++] = index + 1;
+      continue;
+    }
+    for (std::uint32_t k = node.begin; k < node.end; ++k) {
+      const Point &p = points[k];
+      if ((p.type & query.types) && distance2(p.x, p.y, query.x, query.y) <= limit)
+        out.push_back(p.id);
+    }
+  }
+}
+
+void SpatialIndex::in_box(const BoxQuery &query, std::vector<entity_id> &out) const {
+  if (nodes.empty())
+    return;
+  std::uint32_t stack[kStackDepth];
+  std::size_t depth = 0;
+  stack[depth++] = 0;
+  while (depth) {
+    std::uint32_t index = stack[--depth];
+    const Node &node = nodes[index];
+    if (!(node.types & query.types) || node.max_x < query.min_x || node.min_x > query.max_x ||
+        node.max_y < query.min_y || node.min_y > query.max_y)
+      continue;
+
+    // Рамка целиком внутри, и других типов в поддереве нет: берём всех живых
+    bool inside = node.min_x >= query.min_x && node.max_x <= query.max_x && node.min_y >= query.min_y &&
+                  node.max_y <= query.max_y && !(node.types & ~query.types);
+    if (inside) {
+      for (std::uint32_t k = node.begin; k < node.end; ++k) {
+        if (points[k].type)
+          out.push_back(points[k].id);
+      }
+      continue;
+    }
+    if (node.right) {
+      stack[depth++] = node.right;
+      stack[depth++] = index + 1;
+      continue;
+    }
+    for (std::uint32_t k = node.begin; k < node.end; ++k) {
+      const Point &p = points[k];
+      if ((p.type & query.types) && p.x >= query.min_x && p.x <= query.max_x && p.y >= query.min_y &&
+          p.y <= query.max_y)
+        out.push_back(p.id);
+    }
+  }
+}
+
+void SpatialIndex::nearest(const NearestQuery &query, std::vector<entity_id> &out) const {
+  if (nodes.empty() || query.k == 0)
+    return;
+
+  // Куча худших сверху: (расстояние, id), сравнение пар даёт порядок по id при равенстве
+  using Entry = std::pair<std::int64_t, entity_id>;
+  std::vector<Entry> best;
+  best.reserve(std::min(query.k, live));
+  auto worse_than_worst = [&](std::int64_t distance) {
+    return best.size() == query.k && distance > best.front().first;
+  };
+
+  std::uint32_t stack[kStackDepth];
+  std::size_t depth = 0;
+  stack[depth++] = 0;
+  while (depth) {
+    std::uint32_t index = stack[--depth];
+    const Node &node = nodes[index];
+    if (!(node.types & query.types) || worse_than_worst(box_distance2(node, query.x, query.y)))
+      continue;
+    if (node.right) {
+      // Ближний потомок - сверху стека, чтобы куча быстрее заполнилась
+      std::uint32_t near = index + 1;
+      std::uint32_t far = node.right;
+      if (box_distance2(nodes[far], query.x, query.y) < box_distance2(nodes[near], query.x, query.y))
+        std::swap(near, far);
+      stack[depth++] = far;
+      stack[depth++] = near;
+      continue;
+    }
+    for (std::uint32_t k = node.begin; k < node.end; ++k) {
+      const Point &p = points[k];
+      if (!(p.type & query.types)) continue;
+      Entry entry{distance2(p.x, p.y, query.x, query.y), p.id};
+      if (best.size() < query.k) {
+        best.push_back(entry);
+        std::push_heap(best.begin(), best.end());
+      } else if (entry < best.front()) {
+        std::pop_heap(best.begin(), best.end());
+        best.back() = entry;
+        std::push_heap(best.begin(), best.end());
+      }
+    }
+  }
+
+  std::sort_heap(best.begin(), best.end());
+  for (const auto &entry : best)
+    out.push_back(entry.second);
+}
+
+template <class Query, class Fn>
+void SpatialIndex::run_batch(const std::vector<Query> &queries, QueryResults &results, ThreadPool *pool,
+                             Fn &&fn) const {
+  results.ids.clear();
+  results.offsets.assign(1, 0);
+  results.offsets.reserve(queries.size() + 1);
+  if (!pool || queries.size() <= kBatchChunk) {
+    for (const auto &query : queries) {
+      fn(query, results.ids);
+      results.offsets.push_back(results.ids.size());
+    }
+    return;
+  }
+
+  // Части считаются независимо и склеиваются по порядку запросов
+  std::size_t tasks = (queries.size() + kBatchChunk - 1) / kBatchChunk;
+  std::vector<QueryResults> parts(tasks);
+  pool->parallel_for(tasks, [&](std::size_t task, std::size_t) {
+    QueryResults &part = parts[task];
+    std::size_t end = std::min(queries.size(), (task + 1) * kBatchChunk);
+    for (std::size_t q = task * kBatchChunk; q < end; ++q) {
+      fn(queries[q], part.ids);
+      part.offsets.push_back(part.ids.size());
+    }
+  });
+  for (const auto &part : parts) {
+    std::size_t base = results.ids.size();
+    results.ids.insert(results.ids.end(), part.ids.begin(), part.ids.end());
+    for (std::size_t offset : part.offsets)
+      results.offsets.push_back(base + offset);
+  }
+}
+
+void SpatialIndex::query(const std::vector<RadiusQuery> &queries, QueryResults &results, ThreadPool *pool) const {
+  run_batch(queries, results, pool,
+            [this](const RadiusQuery &query, std::vector<entity_id> &out) { within_radius(query, out); });
+}
+
+void SpatialIndex::query(const std::vector<BoxQuery> &queries, QueryResults &results, ThreadPool *pool) const {
+  run_batch(queries, results, pool,
+            [this](const BoxQuery &query, std::vector<entity_id> &out) { in_box(query, out); });
+}
+
+void SpatialIndex::query(const std::vector<NearestQuery> &queries, QueryResults &results, ThreadPool *pool) const {
+  run_batch(queries, results, pool,
+            [this](const NearestQuery &query, std::vector<entity_id> &out) { nearest(query, out); });
+}
@@ -0,0 +1,101 @@
+#include "../include/thread_pool.hpp"
+#include "../include/trace.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t count) {
+  count = std::max<std::size_t>(1, count);
+  for (std::size_t i = 0; i < count; ++i)
+    queues.push_back(std::make_unique<Queue>());
+  for (std::size_t i = 1; i < count; ++i)
+    threads.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+std::size_t ThreadPool::default_threads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::parallel_for(std::size_t tasks, const Job &_job) {
+  if (tasks == 0)
+    return;
+
+  {
+    std::lock_guard lock(mutex);
+    job = &_job;
+    remaining = tasks;
+
+    // Каждый воркер получает непрерывный диапазон задач
+    std::size_t per_worker = (tasks + queues.size() - 1) / queues.size();
+    for (std::size_t w = 0; w < queues.size(); ++w) {
+      std::lock_guard queue_lock(queues[w]->mutex);
+      for (std::size_t t = w * per_worker; t < std::min(tasks, (w + 1) * per_worker); ++t)
+        queues[w]->tasks.push_back(t);
+    }
+    ++generation;
+  }
+  wake.notify_all();
+
+  run_tasks(0);
+
+  std::unique_lock lock(mutex);
+  done.wait(lock, [&] { return remaining == 0; });
+}
+
+void ThreadPool::worker_loop(std::size_t index) {
+  TRACE_THREAD_NAME("pool worker");
+  std::size_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      wake.wait(lock, [&] { return stop || generation != seen; });
+      if (stop)
+        return;
+      seen = generation;
+    }
+    run_tasks(index);
+  }
+}
+
+void ThreadPool::run_tasks(std::size_t index) {
+  std::size_t task;
+  while (pop(index, task) || steal(index, task)) {
+    (*job)(task, index);
+    if (--remaining == 0) {
+      std::lock_guard lock(mutex);
+      done.notify_all();
+    }
+  }
+}
+
+bool ThreadPool::pop(std::size_t index, std::size_t &task) {
+  auto &queue = *queues[index];
+  std::lock_guard lock(queue.mutex);
+  if (queue.tasks.empty())
+    return false;
+  task = queue.tasks.front();
+  queue.tasks.pop_front();
+  return true;
+}
+
+bool ThreadPool::steal(std::size_t index, std::size_t &task) {
+  for (std::size_t k = 1; k < queues.size(); ++k) {
+    auto &queue = *queues[(index + k) % queues.size()];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,73 @@
+#include "../include/tiles.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+TileMap::TileMap(int max_x, int max_y, int _tile_size, int _halo)
+    : tile_size(_tile_size > 0 ? _tile_size : kDefaultTileSize), halo(std::max(0, _halo)) {
+  // Гости ходят только в соседние тайлы, поэтому тайл не уже полосы
+  tile_size = std::max(tile_size, halo);
+  max_x = std::max(0, max_x);
+  max_y = std::max(0, max_y);
+  cols = max_x / tile_size + 1;
+  rows = max_y / tile_size + 1;
+
+  // Общий бюджет ячеек делится между тайлами, чтобы память сеток
+  // не росла с числом тайлов
+  std::size_t max_cells = std::max<std::size_t>(64, SpatialGrid::kMaxCells / (std::size_t(cols) * rows));
+  tiles.reserve(std::size_t(cols) * rows);
+  for (int ty = 0; ty < rows; ++ty) {
+    for (int tx = 0; tx < cols; ++tx) {
+      // Сетка тайла захватывает полосу halo вокруг него, там лежат гости
+      std::int64_t x0 = std::int64_t(tx) * tile_size;
+      std::int64_t y0 = std::int64_t(ty) * tile_size;
+      int min_x = int(std::max<std::int64_t>(0, x0 - halo));
+      int min_y = int(std::max<std::int64_t>(0, y0 - halo));
+      int end_x = int(std::min<std::int64_t>(max_x, x0 + tile_size - 1 + halo));
+      int end_y = int(std::min<std::int64_t>(max_y, y0 + tile_size - 1 + halo));
+      tiles.emplace_back(std::max(1, halo), end_x, end_y, min_x, min_y, max_cells);
+    }
+  }
+}
+
+void TileMap::assign(const World &world) {
+  for (auto &tile : tiles) {
+    tile.owned.clear();
+    tile.guests.clear();
+  }
+  guest_total = 0;
+
+  for (entity_id i : world.active_ids()) {
+    if (!world.alive[i]) continue;
+
+    int x = world.x[i];
+    int y = world.y[i];
+    int tx = std::min(cols - 1, std::max(0, x / tile_size));
+    int ty = std::min(rows - 1, std::max(0, y / tile_size));
+    tiles[std::size_t(ty) * cols + tx].owned.push_back(i);
+
+    // Соседний тайл видит NPC, если до его ближайшей клетки не дальше halo
+    std::int64_t x0 = std::int64_t(tx) * tile_size;
+    std::int64_t y0 = std::int64_t(ty) * tile_size;
+    int from_x = tx > 0 && x - x0 < halo ? -1 : 0;
+    int to_x = tx < cols - 1 && x0 + tile_size - x <= halo ? 1 : 0;
+    int from_y = ty > 0 && y - y0 < halo ? -1 : 0;
+    int to_y = ty < rows - 1 && y0 + tile_size - y <= halo ? 1 : 0;
+    for (int dy = from_y; dy <= to_y; ++dy) {
+      for (int dx = from_x; dx <= to_x; ++dx) {
+        if (!dx && !dy) continue;
+        tiles[std::size_t(ty + dy) * cols + tx + dx].guests.push_back(i);
+        ++guest_total;
+      }
+    }
+  }
+}
+
+void TileMap::build(std::size_t index, const World &world) {
+  Tile &tile = tiles[index];
+  tile.grid.clear();
+  for (entity_id i : tile.owned)
+    tile.grid.insert(i, world.x[i], world.y[i]);
+  for (entity_id i : tile.guests)
+    tile.grid.insert(i, world.x[i], world.y[i]);
+}
@@ -0,0 +1,146 @@
+#include "../include/trace.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+thread_local const char *thread_name = nullptr;
+
+} // namespace
+
+// Буфер одного потока: пишет только владелец, count публикует записанное
+struct Tracer::Buffer {
+  Buffer(std::size_t _capacity, std::uint32_t _tid, std::uint64_t _generation, const char *_name)
+      : events(new TraceEvent[_capacity]), capacity(_capacity), tid(_tid),
+        generation(_generation), name(_name) {}
+
+  std::unique_ptr<TraceEvent[]> events;
+  std::size_t capacity;
+  std::uint32_t tid;
+  std::uint64_t generation;
+  const char *name;
+  std::atomic<std::size_t> count{0};
+  std::atomic<std::uint64_t> dropped{0};
+};
+
+Tracer &Tracer::global() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::start(std::size_t events_per_thread) {
+  std::lock_guard lock(buffers_mutex);
+  if (active.load(std::memory_order_relaxed))
+    return;
+  // Буферы прошлых запусков не освобождаются: поток мог ещё писать в свой
+  capacity = std::max<std::size_t>(1, events_per_thread);
+  origin = std::chrono::steady_clock::now();
+  generation.fetch_add(1, std::memory_order_relaxed);
+  active.store(true, std::memory_order_release);
+}
+
+void Tracer::stop() { active.store(false, std::memory_order_relaxed); }
+
+void Tracer::set_thread_name(const char *name) { thread_name = name; }
+
+Tracer::Buffer *Tracer::local_buffer() {
+  thread_local Buffer *cached = nullptr;
+  std::uint64_t current = generation.load(std::memory_order_acquire);
+  if (!cached || cached->generation != current) {
+    std::lock_guard lock(buffers_mutex);
+    buffers.push_back(std::make_unique<Buffer>(capacity, std::uint32_t(buffers.size() + 1), current,
+                                               thread_name));
+    cached = buffers.back().get();
+  }
+  return cached;
+}
+
+void Tracer::push(char phase, const char *name, std::uint32_t attacker, std::uint32_t defender) {
+  // acquire - чтобы увидеть origin и capacity, записанные в start
+  if (!active.load(std::memory_order_acquire))
+    return;
+
+  // Мгновенных событий (боёв) бывает на порядки больше, чем отрезков фаз:
+  // последняя четверть буфера оставлена под отрезки, чтобы не терять фазы
+  Buffer *buffer = local_buffer();
+  std::size_t n = buffer->count.load(std::memory_order_relaxed);
+  std::size_t limit = phase == 'i' ? buffer->capacity - buffer->capacity / 4 : buffer->capacity;
+  if (n >= limit) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin);
+  buffer->events[n] = {name, std::uint64_t(ts.count()), attacker, defender, phase};
+  buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void Tracer::begin(const char *name) { push('B', name, 0, 0); }
+
+void Tracer::end(const char *name) { push('E', name, 0, 0); }
+
+void Tracer::instant(const char *name, std::uint32_t attacker, std::uint32_t defender) {
+  push('i', name, attacker, defender);
+}
+
+void Tracer::write_chrome_json(std::ostream &os) const {
+  std::lock_guard lock(buffers_mutex);
+  std::uint64_t current = generation.load(std::memory_order_relaxed);
+  auto flags = os.flags();
+  os << std::fixed << std::setprecision(3);
+
+  os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&] {
+    os << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  for (const auto &buffer : buffers) {
+    if (buffer->generation != current)
+      continue;
+
+    if (buffer->name) {
+      separator();
+      os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+         << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+    }
+
+    std::size_t n = buffer->count.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < n; ++i) {
+      const TraceEvent &event = buffer->events[i];
+      separator();
+      os << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+         << "\",\"ts\":" << event.ts_ns / 1000.0 << ",\"pid\":1,\"tid\":" << buffer->tid;
+      if (event.phase == 'i')
+        os << ",\"s\":\"t\",\"args\":{\"attacker\":" << event.attacker << ",\"defender\":"
+           << event.defender << '}';
+      os << '}';
+    }
+  }
+  os << "\n]}\n";
+  os.flags(flags);
+}
+
+std::uint64_t Tracer::recorded() const {
+  std::lock_guard lock(buffers_mutex);
+  std::uint64_t current = generation.load(std::memory_order_relaxed);
+  std::uint64_t total = 0;
+  for (const auto &buffer : buffers) {
+    if (buffer->generation == current)
+      total += buffer->count.load(std::memory_order_acquire);
+  }
+  return total;
+}
+
+std::uint64_t Tracer::dropped() const {
+  std::lock_guard lock(buffers_mutex);
+  std::uint64_t current = generation.load(std::memory_order_relaxed);
+  std::uint64_t total = 0;
+  for (const auto &buffer : buffers) {
+    if (buffer->generation == current)
+      total += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  return total;
+}
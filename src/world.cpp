@@ -0,0 +1,298 @@
+#include "../include/world.hpp"
+#include "../include/dragon.hpp"
+#include "../include/knight.hpp"
+#include "../include/pegasus.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void NameTable::assign(entity_id id, std::string_view name) {
+  Slot &slot = slots[id];
+  long_names.erase(id);
+  if (name.size() < kLong && name.size() <= sizeof(slot.chars)) {
+    std::memcpy(slot.chars, name.data(), name.size());
+    slot.length = std::uint8_t(name.size());
+  } else {
+    long_names.emplace(id, std::string(name));
+    slot.length = kLong;
+  }
+}
+
+bool NameTable::assign_inline(entity_id id, std::string_view name) {
+  Slot &slot = slots[id];
+  if (name.size() >= kLong || name.size() > sizeof(slot.chars))
+    return false;
+  std::memcpy(slot.chars, name.data(), name.size());
+  slot.length = std::uint8_t(name.size());
+  return true;
+}
+
+std::string_view NameTable::get(entity_id id) const {
+  const Slot &slot = slots[id];
+  if (slot.length == kLong)
+    return long_names.at(id);
+  return std::string_view(slot.chars, slot.length);
+}
+
+entity_id World::spawn(NpcType t, int _x, int _y, std::string_view _name) {
+  entity_id id;
+  if (!free_ids.empty()) {
+    id = free_ids.back();
+    free_ids.pop_back();
+    free_index[id] = kNotFree;
+  } else {
+    id = static_cast<entity_id>(type.size());
+    x.push_back(0);
+    y.push_back(0);
+    type.push_back(Unknown);
+    alive.push_back(0);
+    move_distance.push_back(0);
+    kill_distance.push_back(0);
+    generation.push_back(0);
+    scripted.push_back(0);
+    listed.push_back(0);
+    touched.push_back(0);
+    free_index.push_back(kNotFree);
+    names.resize(id + 1);
+  }
+
+  x[id] = _x;
+  y[id] = _y;
+  type[id] = t;
+  alive[id] = 1;
+  ++living;
+  scripted[id] = 0;
+  list_active(id);
+  move_distance[id] = traits[t].move_distance;
+  kill_distance[id] = traits[t].kill_distance;
+  names.assign(id, _name);
+  touch_birth(id);
+  return id;
+}
+
+entity_id World::spawn_bulk(const std::vector<SpawnRecord> &records, ThreadPool *pool) {
+  return spawn_bulk(records.size(), pool, [&](std::size_t i, std::string &) { return records[i]; });
+}
+
+entity_id World::grow(std::size_t count) {
+  entity_id first = entity_id(type.size());
+  std::size_t n = type.size() + count;
+  x.resize(n);
+  y.resize(n);
+  type.resize(n, Unknown);
+  alive.resize(n);
+  move_distance.resize(n);
+  kill_distance.resize(n);
+  generation.resize(n);
+  scripted.resize(n);
+  listed.resize(n);
+  touched.resize(n);
+  free_index.resize(n, kNotFree);
+  names.resize(n);
+  return first;
+}
+
+// Слот новый, поэтому пишутся только его элементы массивов
+void World::place(entity_id id, const SpawnRecord &record, LongNames &long_names) {
+  x[id] = record.x;
+  y[id] = record.y;
+  type[id] = record.type;
+  alive[id] = 1;
+  listed[id] = 1;
+  move_distance[id] = traits[record.type].move_distance;
+  kill_distance[id] = traits[record.type].kill_distance;
+  if (!names.assign_inline(id, record.name))
+    long_names.emplace_back(id, std::string(record.name));
+}
+
+void World::finish_bulk(entity_id first, std::size_t count, std::vector<LongNames> &long_names) {
+  for (auto &chunk : long_names) {
+    for (auto &[id, name] : chunk)
+      names.assign(id, name);
+  }
+  // Новые id больше всех прежних, список остаётся упорядоченным
+  active.reserve(active.size() + count);
+  for (std::size_t i = 0; i < count; ++i) {
+    active.push_back(first + entity_id(i));
+    touch_birth(first + entity_id(i));
+  }
+  living += count;
+}
+
+void World::kill(entity_id id) {
+  if (!alive[id]) return;
+
+  alive[id] = 0;
+  --living;
+  ++generation[id];
+  bury(id);
+  active_dirty = true;
+  touch_life(id);
+}
+
+void World::revive(entity_id id) {
+  if (alive[id]) return;
+
+  // Слот, выросший в restore, на кладбище не попадал
+  if (std::uint32_t at = free_index[id]; at != kNotFree) {
+    free_ids[at] = free_ids.back();
+    free_index[free_ids[at]] = at;
+    free_ids.pop_back();
+    free_index[id] = kNotFree;
+  }
+  alive[id] = 1;
+  ++living;
+  list_active(id);
+  touch_life(id);
+}
+
+void World::restore(entity_id id, NpcType t, int _x, int _y, std::string_view _name) {
+  if (id >= size()) {
+    for (entity_id gap = grow(id + 1 - size()); gap < id; ++gap)
+      bury(gap);
+  }
+  revive(id);
+  x[id] = _x;
+  y[id] = _y;
+  type[id] = t;
+  scripted[id] = 0;
+  move_distance[id] = traits[t].move_distance;
+  kill_distance[id] = traits[t].kill_distance;
+  names.assign(id, _name);
+  touch_birth(id);
+}
+
+void World::bury(entity_id id) {
+  free_index[id] = std::uint32_t(free_ids.size());
+  free_ids.push_back(id);
+}
+
+void World::touch_life(entity_id id) {
+  if (!tracking || (touched[id] & kTouchLife)) return;
+
+  touched[id] |= kTouchLife;
+  life_changed.push_back(id);
+}
+
+void World::touch_birth(entity_id id) {
+  if (!tracking) return;
+
+  touched[id] |= kTouchBirth;
+  touch_life(id);
+}
+
+void World::track_changes(bool on) {
+  tracking = on;
+  std::fill(touched.begin(), touched.end(), 0);
+  life_changed.clear();
+}
+
+void World::collect_changes(WorldChanges &out) {
+  out.died.clear();
+  out.born.clear();
+  out.moved.clear();
+  out.renamed.clear();
+  for (entity_id id : life_changed) {
+    (alive[id] ? out.born : out.died).push_back(id);
+    if (!alive[id] && (touched[id] & kTouchBirth))
+      out.renamed.push_back(id);
+    touched[id] = 0;
+  }
+  life_changed.clear();
+  std::sort(out.died.begin(), out.died.end());
+  std::sort(out.born.begin(), out.born.end());
+  std::sort(out.renamed.begin(), out.renamed.end());
+
+  // Сдвинутый и погибший NPC уже снят с пометок выше, в active его может не быть
+  for (entity_id id : active) {
+    if (touched[id] && alive[id])
+      out.moved.push_back(id);
+    touched[id] = 0;
+  }
+  if (!std::is_sorted(out.moved.begin(), out.moved.end()))
+    std::sort(out.moved.begin(), out.moved.end());
+}
+
+void World::list_active(entity_id id) {
+  if (listed[id]) return;
+
+  listed[id] = 1;
+  active_dirty = active_dirty || (!active.empty() && active.back() > id);
+  active.push_back(id);
+}
+
+void World::compact() {
+  if (!active_dirty) return;
+
+  auto end = std::remove_if(active.begin(), active.end(), [&](entity_id id) {
+    if (alive[id]) return false;
+    listed[id] = 0;
+    return true;
+  });
+  active.erase(end, active.end());
+  if (!std::is_sorted(active.begin(), active.end()))
+    std::sort(active.begin(), active.end());
+  active_dirty = false;
+}
+
+void World::reserve(std::size_t n) {
+  x.reserve(n);
+  y.reserve(n);
+  type.reserve(n);
+  alive.reserve(n);
+  move_distance.reserve(n);
+  listed.reserve(n);
+  touched.reserve(n);
+  free_index.reserve(n);
+  active.reserve(n);
+  kill_distance.reserve(n);
+  generation.reserve(n);
+  scripted.reserve(n);
+  names.reserve(n);
+}
+
+const std::shared_ptr<SlabPool> &World::handle_pool() {
+  if (!pool) {
+    // Блок вмещает самую крупную ручку вместе с блоком управления shared_ptr
+    std::size_t largest = std::max({sizeof(Knight), sizeof(Dragon), sizeof(Pegasus)});
+    pool = std::make_shared<SlabPool>(largest + 64);
+  }
+  return pool;
+}
+
+void World::move(entity_id id, int dx, int dy, int max_x, int max_y) {
+  if (!alive[id]) return;
+
+  int new_x = std::max(0, std::min(max_x, x[id] + dx));
+  int new_y = std::max(0, std::min(max_y, y[id] + dy));
+  // Пометку пишет только поток, двигающий этот id
+  if (tracking && (new_x != x[id] || new_y != y[id]))
+    touched[id] |= kTouchMoved;
+  x[id] = new_x;
+  y[id] = new_y;
+}
+
+bool World::is_close(entity_id a, entity_id b, int distance) const {
+  // Квадраты в 64 битах: на больших картах dx * dx не помещается в int
+  std::int64_t dx = std::int64_t(x[a]) - x[b];
+  std::int64_t dy = std::int64_t(y[a]) - y[b];
+  return dx * dx + dy * dy <= std::int64_t(distance) * distance;
+}
+
+void World::set_traits(NpcType t, NpcTraits value) {
+  traits[t] = value;
+  for (entity_id id = 0; id < size(); ++id) {
+    if (type[id] != t) continue;
+    move_distance[id] = value.move_distance;
+    kill_distance[id] = value.kill_distance;
+  }
+}
+
+int World::max_kill_distance() const {
+  int result = 0;
+  for (const auto &t : traits)
+    result = std::max(result, t.kill_distance);
+  for (int kill_dist : kill_distance)
+    result = std::max(result, kill_dist);
+  return result;
+}
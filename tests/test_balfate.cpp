@@ -2,9 +2,34 @@
 #include "../include/knight.hpp"
 #include "../include/pegasus.hpp"
 #include "../include/npc.hpp"
+#include "../include/grid.hpp"
+#include "../include/rules.hpp"
+#include "../include/snapshot.hpp"
+#include "../include/world.hpp"
+#include "../include/distance.hpp"
+#include "../include/movement.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/fight.hpp"
+#include "../include/journal.hpp"
+#include "../include/combat.hpp"
+#include "../include/behavior.hpp"
+#include "../include/spatial_index.hpp"
+#include "../include/simulation.hpp"
+#include "../include/log.hpp"
+#include "../include/event_bus.hpp"
+#include "../include/frame.hpp"
+#include "../include/render.hpp"
+#include "../include/config.hpp"
+#include "../include/tiles.hpp"
+#include "../include/shard.hpp"
+#include "../include/metrics.hpp"
+#include "../include/trace.hpp"
 #include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
 #include <memory>
 #include <sstream>
+#include <set>
 
 TEST(NPCTest, KnightCreation) {
   Knight k(100, 200, "TestKnight");
@@ -94,6 +119,23 @@ TEST(FightTest, PegasusDoesNotKillPegasus) {
   EXPECT_FALSE(result);
 }
 
+static_assert(can_kill(KnightType, DragonType));
+static_assert(can_kill(DragonType, PegasusType));
+static_assert(!can_kill(PegasusType, KnightType));
+
+TEST(FightTest, TableMatchesVisitorForAllPairs) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs = {
+      std::make_shared<Knight>(world, world.spawn(KnightType, 0, 0, "K")),
+      std::make_shared<Dragon>(world, world.spawn(DragonType, 0, 0, "D")),
+      std::make_shared<Pegasus>(world, world.spawn(PegasusType, 0, 0, "P"))};
+
+  for (auto &attacker : npcs)
+    for (auto &defender : npcs)
+      EXPECT_EQ(defender->accept(attacker), resolve_fight(attacker, defender))
+          << attacker->get_name() << " vs " << defender->get_name();
+}
+
 TEST(SaveLoadTest, KnightSaveLoad) {
   std::stringstream ss;
   Knight k1(100, 200, "TestKnight");
@@ -139,6 +181,213 @@ TEST(SaveLoadTest, PegasusSaveLoad) {
   EXPECT_EQ(p2.get_name(), "TestPegasus");
 }
 
+TEST(SaveLoadTest, BinarySnapshotRoundTrip) {
+  World world;
+  world.spawn(KnightType, 100, 200, "TestKnight");
+  world.spawn(DragonType, 50, 75, "TestDragon");
+  world.spawn(PegasusType, 300, 400, "");
+  world.kill(1);
+
+  std::string path = testing::TempDir() + "snapshot_roundtrip.bin";
+  save_snapshot(world, path);
+
+  SnapshotView view(path);
+  ASSERT_EQ(view.size(), 3u);
+  EXPECT_EQ(view[0].x, 100);
+  EXPECT_EQ(view[1].type, DragonType);
+  EXPECT_EQ(view.name(1), "TestDragon");
+  EXPECT_EQ(view.name(2), "");
+
+  World loaded;
+  view.load_into(loaded);
+  EXPECT_EQ(loaded.x, world.x);
+  EXPECT_EQ(loaded.y, world.y);
+  EXPECT_EQ(loaded.type, world.type);
+  EXPECT_EQ(loaded.alive, world.alive);
+  for (entity_id i = 0; i < world.size(); ++i)
+    EXPECT_EQ(loaded.name(i), world.name(i));
+  std::remove(path.c_str());
+}
+
+TEST(SaveLoadTest, SnapshotLoadsPastDeadSlots) {
+  World source;
+  source.spawn(KnightType, 1, 2, "A");
+  source.spawn(DragonType, 3, 4, "B");
+  source.spawn(PegasusType, 5, 6, "C");
+  source.kill(1);
+  std::string path = testing::TempDir() + "snapshot_graveyard.bin";
+  save_snapshot(source, path);
+
+  World world;
+  world.spawn(KnightType, 0, 0, "Old0");
+  world.spawn(KnightType, 0, 0, "Old1");
+  world.spawn(DragonType, 0, 0, "Old2");
+  world.kill(0);
+  world.kill(2);
+
+  entity_id first = SnapshotView(path).load_into(world);
+  EXPECT_EQ(first, 3u);
+  ASSERT_EQ(world.size(), 6u);
+  EXPECT_EQ(world.free_count(), 3u);
+  EXPECT_TRUE(world.alive[1]);
+  EXPECT_EQ(world.name(1), "Old1");
+  for (entity_id i = 0; i < source.size(); ++i) {
+    EXPECT_EQ(world.name(first + i), source.name(i));
+    EXPECT_EQ(world.x[first + i], source.x[i]);
+    EXPECT_EQ(world.alive[first + i], source.alive[i]);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(SaveLoadTest, SnapshotBadTypeLeavesWorldUntouched) {
+  World source;
+  source.spawn(KnightType, 1, 2, "A");
+  source.spawn(DragonType, 3, 4, "B");
+  std::string path = testing::TempDir() + "snapshot_bad_type.bin";
+  save_snapshot(source, path);
+  {
+    std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+    fs.seekp(sizeof(SnapshotHeader) + sizeof(SnapshotRecord) + offsetof(SnapshotRecord, type));
+    fs.put(char(42));
+  }
+
+  World world;
+  world.spawn(KnightType, 0, 0, "Old");
+  EXPECT_THROW(SnapshotView(path).load_into(world), std::runtime_error);
+  EXPECT_EQ(world.size(), 1u);
+  EXPECT_EQ(world.alive_count(), 1u);
+  std::remove(path.c_str());
+}
+
+TEST(SaveLoadTest, SnapshotRejectsForeignFile) {
+  std::string path = testing::TempDir() + "snapshot_foreign.bin";
+  {
+    std::ofstream os(path);
+    os << "definitely not a snapshot, but long enough to hold a header";
+  }
+  EXPECT_THROW(SnapshotView view(path), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(SaveLoadTest, SnapshotRejectsOverflowingCount) {
+  World world;
+  for (int i = 0; i < 3; ++i)
+    world.spawn(KnightType, i, i, "K");
+  std::string path = testing::TempDir() + "snapshot_count.bin";
+  save_snapshot(world, path);
+
+  // 2^61 * 24 == 3 * 2^64: без проверки count * sizeof(SnapshotRecord)
+  // сходится с настоящим strings_offset
+  static_assert(sizeof(SnapshotRecord) == 24);
+  std::uint64_t count = 3 + (std::uint64_t(1) << 61);
+  {
+    std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+    fs.seekp(offsetof(SnapshotHeader, count));
+    fs.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  }
+  EXPECT_THROW(SnapshotView view(path), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(SaveLoadTest, SnapshotRejectsBadNamesAndCoordinates) {
+  World source;
+  source.spawn(KnightType, 1, 2, "Arthur");
+  source.spawn(DragonType, 3, 4, "Smaug");
+  std::string path = testing::TempDir() + "snapshot_bad_record.bin";
+  auto patched = [&](std::size_t field, const auto &value) {
+    save_snapshot(source, path);
+    std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+    fs.seekp(sizeof(SnapshotHeader) + sizeof(SnapshotRecord) + field);
+    fs.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+
+  // offset + length переполняется и проходил бы проверку суммой
+  patched(offsetof(SnapshotRecord, name_offset), ~std::uint64_t(0) - 2);
+  {
+    SnapshotView view(path);
+    EXPECT_EQ(view.name(1), "");
+    World world;
+    EXPECT_THROW(view.load_into(world), std::runtime_error);
+    EXPECT_EQ(world.size(), 0u);
+  }
+
+  patched(offsetof(SnapshotRecord, x), std::int32_t(-5));
+  {
+    World world;
+    EXPECT_THROW(SnapshotView(path).load_into(world), std::runtime_error);
+    EXPECT_EQ(world.size(), 0u);
+  }
+  patched(offsetof(SnapshotRecord, y), std::int32_t(kMaxCoordinate + 1));
+  {
+    World world;
+    EXPECT_THROW(SnapshotView(path).load_into(world), std::runtime_error);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(SaveLoadTest, TextExportMatchesNpcSave) {
+  World world;
+  world.spawn(KnightType, 100, 200, "TestKnight");
+  world.spawn(PegasusType, 300, 400, "Test Pegasus");
+
+  std::stringstream exported, saved;
+  export_text(world, exported);
+  Knight(100, 200, "TestKnight").save(saved);
+  Pegasus(300, 400, "Test Pegasus").save(saved);
+  EXPECT_EQ(exported.str(), saved.str());
+
+  World imported;
+  EXPECT_EQ(import_text(imported, exported), 2u);
+  for (entity_id i = 0; i < world.size(); ++i)
+    EXPECT_EQ(imported.name(i), world.name(i));
+  EXPECT_EQ(imported.type, world.type);
+}
+
+TEST(SaveLoadTest, ParallelTextImportMatchesSerial) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 200000, 10000, 10000, 12);
+  world.spawn(DragonType, 5, 6, "An exceptionally long dragon name that is not stored inline");
+  std::stringstream exported;
+  export_text(world, exported);
+  std::string text = exported.str();
+
+  World serial, parallel;
+  ThreadPool pool(4);
+  EXPECT_EQ(import_text(serial, text), world.size());
+  EXPECT_EQ(import_text(parallel, text, &pool), world.size());
+  EXPECT_EQ(parallel.type, serial.type);
+  EXPECT_EQ(world_hash(parallel), world_hash(serial));
+  EXPECT_EQ(world_hash(parallel), world_hash(world));
+  for (entity_id id = 0; id < world.size(); ++id)
+    ASSERT_EQ(parallel.name(id), world.name(id));
+  EXPECT_EQ(parallel.active_ids().size(), world.size());
+}
+
+TEST(SaveLoadTest, TextImportReportsBadLine) {
+  World world;
+  auto error_of = [&](std::string_view text) {
+    try {
+      import_text(world, text);
+    } catch (const std::runtime_error &e) {
+      return std::string(e.what());
+    }
+    return std::string();
+  };
+  EXPECT_NE(error_of("1\n2\n3\nKnight\n2\n5\nx\nDragon\n").find("line 7"), std::string::npos);
+  EXPECT_NE(error_of("1\n2\n3\nKnight\n9\n5\n6\nDragon\n").find("unknown NPC type"), std::string::npos);
+  EXPECT_NE(error_of("1\n2\n3\nKnight\n2\n5\n").find("truncated"), std::string::npos);
+  EXPECT_NE(error_of("1\n2\n3\nKnight\n2\n-1\n6\nDragon\n").find("line 6: coordinate"), std::string::npos);
+  EXPECT_NE(error_of("1\n2\n3\nKnight\n2\n5\n" + std::to_string(kMaxCoordinate + 1) + "\nDragon\n").find("line 7"),
+            std::string::npos);
+  EXPECT_EQ(world.size(), 0u);
+
+  // Последняя строка без перевода строки и '\r' в числах допускаются
+  EXPECT_EQ(import_text(world, std::string_view("2\r\n 7\n8\nSmaug")), 1u);
+  EXPECT_EQ(world.name(0), "Smaug");
+  EXPECT_EQ(world.x[0], 7);
+}
+
 class MockObserver : public IFightObserver {
 public:
   int fight_count = 0;
@@ -180,6 +429,70 @@ TEST(ObserverTest, MultipleObservers) {
   EXPECT_EQ(obs2->fight_count, 1);
 }
 
+class BatchObserver : public IEventObserver {
+public:
+  int batches = 0;
+  std::vector<FightOutcome> events;
+
+  void on_events(const std::vector<FightOutcome> &batch) override {
+    batches++;
+    events.insert(events.end(), batch.begin(), batch.end());
+  }
+};
+
+TEST(EventBusTest, DispatchesOneBatchPerTick) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 3, 0, 0, 1);
+  auto observer = std::make_shared<BatchObserver>();
+  world.events.subscribe(observer);
+  world.events.set_tick(5);
+
+  for (auto &attacker : npcs)
+    for (auto &defender : npcs)
+      resolve_fight(attacker, defender);
+  EXPECT_EQ(observer->batches, 0);
+  EXPECT_EQ(world.events.pending(), 9u);
+
+  EXPECT_EQ(world.events.dispatch(), 9u);
+  EXPECT_EQ(observer->batches, 1);
+  ASSERT_EQ(observer->events.size(), 9u);
+  EXPECT_EQ(observer->events[0].tick, 5u);
+  EXPECT_EQ(world.events.dispatch(), 0u);
+  EXPECT_EQ(observer->batches, 1);
+}
+
+TEST(EventBusTest, FiltersByKindAndType) {
+  World world;
+  auto knight = std::make_shared<Knight>(world, world.spawn(KnightType, 0, 0, "K"));
+  auto dragon = std::make_shared<Dragon>(world, world.spawn(DragonType, 0, 0, "D"));
+  auto pegasus = std::make_shared<Pegasus>(world, world.spawn(PegasusType, 0, 0, "P"));
+
+  auto kills = std::make_shared<BatchObserver>();
+  auto dragons = std::make_shared<BatchObserver>();
+  EventFilter dragon_filter;
+  dragon_filter.attacker_types = 1u << DragonType;
+  world.events.subscribe(kills, EventFilter::only(FightKind::Kill));
+  auto id = world.events.subscribe(dragons, dragon_filter);
+
+  resolve_fight(knight, dragon);
+  resolve_fight(dragon, pegasus);
+  resolve_fight(dragon, knight);
+  resolve_fight(pegasus, knight);
+  world.events.dispatch();
+
+  ASSERT_EQ(kills->events.size(), 2u);
+  EXPECT_EQ(kills->events[1].attacker, dragon->get_id());
+  ASSERT_EQ(dragons->events.size(), 2u);
+  EXPECT_EQ(dragons->events[1].kind, FightKind::Fight);
+
+  world.events.unsubscribe(id);
+  resolve_fight(dragon, pegasus);
+  world.events.dispatch();
+  EXPECT_EQ(dragons->events.size(), 2u);
+  EXPECT_EQ(kills->events.size(), 3u);
+}
+
 TEST(BattleTest, ChainReaction) {
   auto knight = std::make_shared<Knight>(0, 0, "K");
   auto dragon = std::make_shared<Dragon>(5, 0, "D");
@@ -206,6 +519,1435 @@ TEST(DistanceTest, DiagonalDistance) {
   EXPECT_FALSE(k1->is_close(k2, 49));
 }
 
+TEST(GridTest, FindsNeighbourAcrossCellBorder) {
+  SpatialGrid grid(30, 100, 100);
+  grid.insert(0, 29, 29);
+  grid.insert(1, 31, 31);
+  grid.insert(2, 95, 95);
+
+  std::set<size_t> found;
+  grid.for_each_near(29, 29, [&](size_t id) { found.insert(id); });
+  EXPECT_EQ(found, (std::set<size_t>{0, 1}));
+}
+
+TEST(GridTest, UpdateMovesBetweenCells) {
+  SpatialGrid grid(10, 100, 100);
+  grid.insert(0, 5, 5);
+  grid.update(0, 5, 5, 55, 55);
+
+  int near_old = 0, near_new = 0;
+  grid.for_each_near(5, 5, [&](size_t) { near_old++; });
+  grid.for_each_near(55, 55, [&](size_t) { near_new++; });
+  EXPECT_EQ(near_old, 0);
+  EXPECT_EQ(near_new, 1);
+  EXPECT_EQ(grid.size(), 1u);
+}
+
+TEST(GridTest, MatchesBruteForce) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<> coord(0, 200);
+  std::vector<std::shared_ptr<NPC>> npcs;
+  for (int i = 0; i < 300; ++i)
+    npcs.push_back(std::make_shared<Dragon>(coord(gen), coord(gen), "D"));
+
+  SpatialGrid grid(30, 200, 200);
+  for (size_t i = 0; i < npcs.size(); ++i)
+    grid.insert(i, npcs[i]->get_x(), npcs[i]->get_y());
+
+  for (size_t i = 0; i < npcs.size(); ++i) {
+    std::set<size_t> brute, fast;
+    for (size_t j = 0; j < npcs.size(); ++j)
+      if (i != j && npcs[i]->is_close(npcs[j], 30))
+        brute.insert(j);
+    grid.for_each_near(npcs[i]->get_x(), npcs[i]->get_y(), [&](size_t j) {
+      if (i != j && npcs[i]->is_close(npcs[j], 30))
+        fast.insert(j);
+    });
+    EXPECT_EQ(brute, fast);
+  }
+}
+
+TEST(WorldTest, HandlesReadFromWorld) {
+  World world;
+  auto knight = std::make_shared<Knight>(world, world.spawn(KnightType, 1, 2, "K"));
+  auto dragon = std::make_shared<Dragon>(world, world.spawn(DragonType, 3, 4, "D"));
+
+  EXPECT_EQ(world.size(), 2u);
+  EXPECT_EQ(dragon->get_id(), 1u);
+  EXPECT_EQ(dragon->get_x(), 3);
+  EXPECT_EQ(dragon->get_kill_distance(), 30);
+  EXPECT_EQ(knight->get_move_distance(), 30);
+
+  knight->move(10, 10, 100, 100);
+  EXPECT_EQ(world.x[0], 11);
+  EXPECT_EQ(world.y[0], 12);
+
+  EXPECT_TRUE(dragon->accept(knight));
+  dragon->set_alive(false);
+  EXPECT_EQ(world.alive_count(), 1u);
+}
+
+TEST(WorldTest, DeadNpcDoesNotMove) {
+  World world;
+  entity_id id = world.spawn(PegasusType, 5, 5, "P");
+  world.kill(id);
+  world.move(id, 30, 30, 100, 100);
+  EXPECT_EQ(world.x[id], 5);
+  EXPECT_EQ(world.y[id], 5);
+}
+
+TEST(WorldTest, DeadSlotIsReusedAndOldRefExpires) {
+  World world;
+  world.spawn(KnightType, 1, 1, "K");
+  entity_id dragon = world.spawn(DragonType, 2, 2, "D");
+  EntityRef old_ref = world.ref(dragon);
+
+  world.kill(dragon);
+  EXPECT_FALSE(world.is_valid(old_ref));
+  EXPECT_EQ(world.free_count(), 1u);
+
+  entity_id pegasus = world.spawn(PegasusType, 7, 8, "P");
+  EXPECT_EQ(pegasus, dragon);
+  EXPECT_EQ(world.size(), 2u);
+  EXPECT_EQ(world.type[pegasus], PegasusType);
+  EXPECT_EQ(world.name(pegasus), "P");
+  EXPECT_FALSE(world.is_valid(old_ref));
+  EXPECT_TRUE(world.is_valid(world.ref(pegasus)));
+}
+
+// Погибшие выпадают из списка живых на compact, занятый заново слот - не дублируется
+TEST(WorldTest, ActiveIdsTrackLiving) {
+  World world;
+  for (int i = 0; i < 5; ++i)
+    world.spawn(KnightType, i, i, "K" + std::to_string(i));
+  world.kill(1);
+  world.kill(3);
+  EXPECT_EQ(world.active_ids().size(), 5u);
+  world.compact();
+  EXPECT_EQ(world.active_ids(), (std::vector<entity_id>{0, 2, 4}));
+  EXPECT_EQ(world.graveyard(), (std::vector<entity_id>{1, 3}));
+
+  EXPECT_EQ(world.spawn(DragonType, 9, 9, "D"), 3u);
+  world.kill(4);
+  EXPECT_EQ(world.spawn(DragonType, 9, 9, "D2"), 4u);
+  world.compact();
+  EXPECT_EQ(world.active_ids(), (std::vector<entity_id>{0, 2, 3, 4}));
+  EXPECT_EQ(world.graveyard(), (std::vector<entity_id>{1}));
+  // Погибший слот хранит последнюю запись до переиспользования
+  EXPECT_EQ(world.name(1), "K1");
+  EXPECT_EQ(world.x[1], 1);
+}
+
+// Оживлённый слот уходит с кладбища, остальные погибшие на нём остаются
+TEST(WorldTest, ReviveTakesSlotOffGraveyard) {
+  World world;
+  for (int i = 0; i < 6; ++i)
+    world.spawn(KnightType, i, i, "K" + std::to_string(i));
+  for (entity_id id : {1u, 2u, 3u, 4u})
+    world.kill(id);
+  world.revive(2);
+  world.revive(2);
+  world.revive(4);
+  std::vector<entity_id> graveyard = world.graveyard();
+  std::sort(graveyard.begin(), graveyard.end());
+  EXPECT_EQ(graveyard, (std::vector<entity_id>{1, 3}));
+  EXPECT_EQ(world.alive_count(), 4u);
+
+  // Слоты до восстановленного ложатся на кладбище, сам он - нет
+  world.restore(8, DragonType, 1, 1, "D");
+  world.revive(7);
+  graveyard = world.graveyard();
+  std::sort(graveyard.begin(), graveyard.end());
+  EXPECT_EQ(graveyard, (std::vector<entity_id>{1, 3, 6}));
+
+  std::vector<entity_id> reused;
+  for (int i = 0; i < 3; ++i)
+    reused.push_back(world.spawn(PegasusType, 0, 0, "P"));
+  std::sort(reused.begin(), reused.end());
+  EXPECT_EQ(reused, (std::vector<entity_id>{1, 3, 6}));
+  EXPECT_EQ(world.spawn(PegasusType, 0, 0, "P"), 9u);
+}
+
+TEST(WorldTest, LongNamesSurviveOverwrite) {
+  World world;
+  std::string long_name(40, 'x');
+  entity_id a = world.spawn(KnightType, 0, 0, long_name);
+  entity_id b = world.spawn(KnightType, 0, 0, "exactly_23_characters__");
+  EXPECT_EQ(world.name(a), long_name);
+  EXPECT_EQ(world.name(b), "exactly_23_characters__");
+
+  world.kill(a);
+  world.spawn(DragonType, 0, 0, "short");
+  EXPECT_EQ(world.name(a), "short");
+}
+
+TEST(WorldTest, BulkSpawnIsSameForAnyPool) {
+  PopulationSpec spec{100000, 500, 500, 9, {0, 2, 1, 1}};
+  World serial, parallel;
+  std::vector<std::shared_ptr<NPC>> serial_npcs, parallel_npcs;
+  ThreadPool pool(4);
+  spawn_population(serial, serial_npcs, spec);
+  spawn_population(parallel, parallel_npcs, spec, &pool);
+
+  EXPECT_EQ(world_hash(parallel), world_hash(serial));
+  EXPECT_EQ(parallel.type, serial.type);
+  EXPECT_EQ(parallel.name(77777), serial.name(77777));
+  EXPECT_EQ(parallel.alive_count(), spec.count);
+  EXPECT_EQ(parallel.active_ids().size(), spec.count);
+  ASSERT_EQ(parallel_npcs.size(), spec.count);
+  EXPECT_EQ(parallel_npcs[123]->get_name(), serial.name(123));
+
+  std::size_t knights = std::count(parallel.type.begin(), parallel.type.end(), KnightType);
+  EXPECT_NEAR(double(knights) / spec.count, 0.5, 0.01);
+  EXPECT_EQ(std::count(parallel.type.begin(), parallel.type.end(), Unknown), 0);
+
+  // Новые слоты идут после старых, кладбище не занимается
+  parallel.kill(5);
+  std::vector<SpawnRecord> records = {{DragonType, 1, 2, "Short"},
+                                      {PegasusType, 3, 4, "A pegasus whose name is far too long to inline"}};
+  entity_id first = parallel.spawn_bulk(records, &pool);
+  EXPECT_EQ(first, spec.count);
+  EXPECT_EQ(parallel.name(first + 1), records[1].name);
+  EXPECT_EQ(parallel.kill_distance[first], parallel.get_traits(DragonType).kill_distance);
+  EXPECT_EQ(parallel.free_count(), 1u);
+}
+
+TEST(WorldTest, PooledHandlesShareSlab) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 100, 100, 100, 1);
+  EXPECT_EQ(world.handle_pool()->in_use(), 100u);
+  EXPECT_EQ(world.handle_pool()->slab_count(), 1u);
+  EXPECT_EQ(npcs[42]->get_id(), 42u);
+
+  npcs[42]->set_alive(false);
+  npcs.pop_back();
+  EXPECT_EQ(world.handle_pool()->in_use(), 99u);
+  EXPECT_EQ(world.free_count(), 1u);
+}
+
+class SimdDistanceTest : public testing::TestWithParam<SimdLevel> {
+protected:
+  void SetUp() override {
+    previous = get_simd_level();
+    set_simd_level(GetParam());
+  }
+  void TearDown() override { set_simd_level(previous); }
+
+  SimdLevel previous;
+};
+
+TEST_P(SimdDistanceTest, ExactlyAtBorder) {
+  int xs[] = {5, 0, 3, 4, 6};
+  int ys[] = {0, 5, 4, 4, 0};
+  EXPECT_EQ(within_distance_mask(0, 0, xs, ys, 5, 5), 0b00111u);
+  EXPECT_EQ(within_distance_mask(0, 0, xs, ys, 5, 4), 0b00000u);
+}
+
+TEST_P(SimdDistanceTest, LargeCoordinatesDoNotOverflow) {
+  int xs[] = {60000000, 0, 60000000 - 46341};
+  int ys[] = {60000000, 0, 60000000};
+  EXPECT_EQ(within_distance_mask(60000000, 60000000, xs, ys, 3, 46341), 0b101u);
+}
+
+TEST_P(SimdDistanceTest, MatchesIsClose) {
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<> coord(0, 100);
+  std::vector<std::shared_ptr<NPC>> npcs;
+  std::vector<int> xs, ys;
+  for (int i = 0; i < 150; ++i) {
+    xs.push_back(coord(gen));
+    ys.push_back(coord(gen));
+    npcs.push_back(std::make_shared<Knight>(xs.back(), ys.back(), "K"));
+  }
+
+  std::vector<std::uint32_t> out(xs.size());
+  size_t found = within_distance(xs[0], ys[0], xs.data(), ys.data(), xs.size(), 30, out.data());
+
+  std::vector<std::uint32_t> expected;
+  for (size_t k = 0; k < npcs.size(); ++k)
+    if (npcs[0]->is_close(npcs[k], 30))
+      expected.push_back(k);
+  EXPECT_EQ(std::vector<std::uint32_t>(out.begin(), out.begin() + found), expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, SimdDistanceTest,
+                         testing::Values(SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2));
+
+TEST(ThreadPoolTest, RunsEveryTaskOnce) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> hits(1000);
+  for (int round = 0; round < 3; ++round)
+    pool.parallel_for(hits.size(), [&](size_t task, size_t) { hits[task]++; });
+
+  for (auto &h : hits)
+    EXPECT_EQ(h.load(), 3);
+}
+
+namespace {
+
+void fill_world(World &world, size_t n, int side) {
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<> coord(0, side);
+  for (size_t i = 0; i < n; ++i)
+    world.spawn(NpcType(i % 3 + 1), coord(gen), coord(gen), "N");
+}
+
+} // namespace
+
+TEST(MovementTest, SameSeedSameResultAcrossThreadCounts) {
+  World serial_world, parallel_world;
+  fill_world(serial_world, 5000, 1000);
+  fill_world(parallel_world, 5000, 1000);
+
+  ThreadPool pool(4);
+  MovementSystem serial(serial_world, 1000, 1000, 123);
+  MovementSystem parallel(parallel_world, 1000, 1000, 123, &pool);
+
+  for (int tick = 0; tick < 5; ++tick) {
+    auto a = serial.tick();
+    auto b = parallel.tick();
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t k = 0; k < a.size(); ++k) {
+      EXPECT_EQ(a[k].attacker, b[k].attacker);
+      EXPECT_EQ(a[k].defender, b[k].defender);
+    }
+  }
+  EXPECT_EQ(serial_world.x, parallel_world.x);
+  EXPECT_EQ(serial_world.y, parallel_world.y);
+}
+
+TEST(MovementTest, CandidatesMatchBruteForce) {
+  World world;
+  fill_world(world, 400, 200);
+  MovementSystem movement(world, 200, 200, 9);
+  auto candidates = movement.tick();
+
+  std::set<std::pair<entity_id, entity_id>> fast, brute;
+  for (auto &c : candidates)
+    fast.insert({c.attacker, c.defender});
+  for (entity_id i = 0; i < world.size(); ++i)
+    for (entity_id j = 0; j < world.size(); ++j)
+      if (i != j && world.is_close(i, j, world.kill_distance[i]))
+        brute.insert({i, j});
+  EXPECT_EQ(fast, brute);
+}
+
+TEST(MovementTest, TileSizeDoesNotChangeOutcome) {
+  World whole_world, tiled_world;
+  fill_world(whole_world, 3000, 1000);
+  fill_world(tiled_world, 3000, 1000);
+
+  MovementSystem whole(whole_world, 1000, 1000, 77);
+  MovementSystem tiled(tiled_world, 1000, 1000, 77, nullptr, 64);
+  EXPECT_EQ(whole.get_tiles().tile_count(), 1u);
+  EXPECT_EQ(tiled.get_tiles().tile_count(), 16u * 16u);
+
+  for (int tick = 0; tick < 3; ++tick) {
+    auto a = whole.tick();
+    auto b = tiled.tick();
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t k = 0; k < a.size(); ++k) {
+      EXPECT_EQ(a[k].attacker, b[k].attacker);
+      EXPECT_EQ(a[k].defender, b[k].defender);
+    }
+  }
+  EXPECT_GT(tiled.get_tiles().guest_count(), 0u);
+}
+
+// Пары через границу тайла находятся только благодаря гостям
+TEST(TileMapTest, GuestsCoverBorderPairs) {
+  World world;
+  world.spawn(KnightType, 99, 50, "A");  // тайл (0, 0)
+  world.spawn(DragonType, 105, 50, "B"); // тайл (1, 0)
+  world.spawn(DragonType, 109, 109, "C"); // тайл (1, 1), гость трёх соседей
+  world.spawn(DragonType, 140, 50, "D"); // далеко от границы
+  TileMap tiles(1000, 1000, 100, 30);
+  tiles.assign(world);
+  for (std::size_t t = 0; t < tiles.tile_count(); ++t)
+    tiles.build(t, world);
+
+  EXPECT_EQ(tiles.owned(0), std::vector<entity_id>{0});
+  EXPECT_EQ(tiles.guests(0), (std::vector<entity_id>{1, 2}));
+  EXPECT_EQ(tiles.guests(1), (std::vector<entity_id>{0, 2}));
+  EXPECT_EQ(tiles.guests(11), (std::vector<entity_id>{2})); // тайл (0, 1)
+  EXPECT_EQ(tiles.guest_count(), 5u);
+
+  std::vector<std::size_t> found;
+  tiles.for_each_within(0, 99, 50, 10, [&](std::size_t j) { found.push_back(j); });
+  std::sort(found.begin(), found.end());
+  EXPECT_EQ(found, (std::vector<std::size_t>{0, 1}));
+}
+
+TEST(MovementTest, HugeMapMatchesBruteForce) {
+  // Карта 1 000 000 x 1 000 000: квадраты разностей не влезают в int,
+  // а сетка на всю карту с ячейкой 30 заняла бы миллиард ячеек
+  const int side = 1000000;
+  World world;
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<> coord(0, side);
+  std::uniform_int_distribution<> offset(-20, 20);
+  for (int k = 0; k < 300; ++k) {
+    // Кучки у случайной точки, часть - поперёк границ тайлов
+    int cx = k % 3 ? coord(gen) : (coord(gen) / 16384) * 16384;
+    int cy = coord(gen);
+    for (int m = 0; m < 4; ++m)
+      world.spawn(NpcType(m % 3 + 1), std::clamp(cx + offset(gen), 0, side),
+                  std::clamp(cy + offset(gen), 0, side), "N");
+  }
+  world.spawn(KnightType, 0, 0, "Far");
+  world.spawn(DragonType, side, side, "Far");
+
+  MovementSystem movement(world, side, side, 5);
+  EXPECT_GT(movement.get_tiles().tile_count(), 1u);
+  auto candidates = movement.tick();
+
+  std::set<std::pair<entity_id, entity_id>> fast, brute;
+  for (auto &c : candidates)
+    fast.insert({c.attacker, c.defender});
+  for (entity_id i = 0; i < world.size(); ++i)
+    for (entity_id j = 0; j < world.size(); ++j)
+      if (i != j && world.is_close(i, j, world.kill_distance[i]))
+        brute.insert({i, j});
+  EXPECT_EQ(fast, brute);
+  EXPECT_FALSE(world.is_close(world.size() - 2, world.size() - 1, 1000000));
+}
+
+TEST(ConfigTest, ReadsKeysAndTypeDistances) {
+  std::istringstream is("# большая карта\n"
+                        "seed = 42\n"
+                        "npcs=2000000\n"
+                        "map = 1000000 500000  # ширина и высота\n"
+                        "tile = 8192\n"
+                        "behaviors = 1\n"
+                        "dragon.kill = 45\n"
+                        "\n"
+                        "knight.move = 5\n");
+  SimulationConfig config;
+  config.ticks = 7;
+  load_config(is, config);
+  EXPECT_EQ(config.seed, 42u);
+  EXPECT_EQ(config.npc_count, 2000000u);
+  EXPECT_EQ(config.max_x, 1000000);
+  EXPECT_EQ(config.max_y, 500000);
+  EXPECT_EQ(config.tile_size, 8192);
+  EXPECT_TRUE(config.behaviors);
+  EXPECT_EQ(config.ticks, 7u);
+  EXPECT_EQ(config.traits[DragonType].kill_distance, 45);
+  EXPECT_EQ(config.traits[DragonType].move_distance, npc_traits[DragonType].move_distance);
+  EXPECT_EQ(config.traits[KnightType].move_distance, 5);
+  EXPECT_NO_THROW(validate_config(config));
+
+  World world;
+  world.spawn(DragonType, 0, 0, "D");
+  configure_world(world, config);
+  EXPECT_EQ(world.kill_distance[0], 45);
+  EXPECT_EQ(world.max_kill_distance(), 45);
+  EXPECT_EQ(world.kill_distance[world.spawn(DragonType, 1, 1, "E")], 45);
+}
+
+TEST(ConfigTest, RejectsBadLinesAndLimits) {
+  SimulationConfig config;
+  std::istringstream unknown("seed = 1\nspeed = 3\n");
+  EXPECT_THROW(load_config(unknown, config), std::runtime_error);
+  std::istringstream garbage("npcs = 10 dragons\n");
+  EXPECT_THROW(load_config(garbage, config), std::runtime_error);
+  std::istringstream negative("npcs = -1\n");
+  EXPECT_THROW(load_config(negative, config), std::runtime_error);
+
+  config.max_x = kMaxCoordinate + 1;
+  EXPECT_THROW(validate_config(config), std::runtime_error);
+}
+
+TEST(FrameBufferTest, HeldFrameSkipsPublish) {
+  World world;
+  world.spawn(KnightType, 1, 2, "K");
+  FrameBuffer frames;
+
+  EXPECT_TRUE(frames.publish(world, 1));
+  {
+    auto held = frames.acquire();
+    world.x[0] = 10;
+    EXPECT_TRUE(frames.publish(world, 2));
+    // Кадр 1 всё ещё у читателя - писать в него нельзя
+    EXPECT_FALSE(frames.publish(world, 3));
+    EXPECT_EQ(held->tick, 1u);
+    EXPECT_EQ(held->x[0], 1);
+  }
+  EXPECT_EQ(frames.acquire()->tick, 2u);
+  EXPECT_TRUE(frames.publish(world, 3));
+  EXPECT_EQ(frames.acquire()->x[0], 10);
+  EXPECT_EQ(frames.skipped(), 1u);
+}
+
+// Поток тика пишет мир без блокировок, читатель видит только целые кадры
+TEST(FrameBufferTest, ReaderSeesWholeTicks) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 500, 1000, 1000, 3);
+  std::fill(world.x.begin(), world.x.end(), 0);
+  FrameBuffer frames;
+  frames.publish(world, 0);
+  std::atomic<bool> running{true};
+
+  std::thread reader([&] {
+    while (running) {
+      auto frame = frames.acquire();
+      for (std::size_t i = 1; i < frame->size(); ++i)
+        ASSERT_EQ(frame->x[i], frame->x[0]);
+      EXPECT_EQ(frame->alive_count, frame->size());
+    }
+  });
+
+  for (int tick = 1; tick <= 2000; ++tick) {
+    for (auto &npc : npcs)
+      world.x[npc->get_id()] = tick;
+    frames.publish(world, tick);
+  }
+  running = false;
+  reader.join();
+  EXPECT_EQ(frames.published() + frames.skipped(), 2001u);
+}
+
+TEST(MapRendererTest, DensityCountsEveryLivingNpc) {
+  World world;
+  world.spawn(KnightType, 0, 0, "A");
+  world.spawn(KnightType, 1, 1, "B");
+  world.spawn(DragonType, 99, 99, "C");
+  world.spawn(DragonType, 50, 0, "D");
+  world.kill(3);
+  FrameBuffer frames;
+  frames.publish(world, 1);
+
+  MapRenderer renderer(RenderMode::Density, 99, 99, 4, 2);
+  std::string out;
+  renderer.render(*frames.acquire(), world, out);
+  EXPECT_EQ(out, "Density 4x2, up to 2 per cell\n"
+                 "+----+\n"
+                 "|@   |\n"
+                 "|   .|\n"
+                 "+----+\n");
+}
+
+TEST(MapRendererTest, DiffPrintsOnlyChanges) {
+  World world;
+  world.spawn(KnightType, 0, 0, "A");
+  world.spawn(KnightType, 5, 5, "B");
+  world.spawn(DragonType, 9, 9, "C");
+  FrameBuffer frames;
+  MapRenderer renderer(RenderMode::Diff, 100, 100);
+  std::string out;
+
+  frames.publish(world, 1);
+  renderer.render(*frames.acquire(), world, out);
+  EXPECT_EQ(out, "Diff baseline: 3 alive\n");
+
+  world.x[0] = 1;
+  world.spawn(PegasusType, 7, 3, "D");
+  world.kill(1);
+  frames.publish(world, 2);
+  out.clear();
+  renderer.render(*frames.acquire(), world, out);
+  EXPECT_EQ(out, "~ A (0, 0) -> (1, 0)\n"
+                 "- B\n"
+                 "+ D at (7, 3)\n"
+                 "Changed: 3\n");
+
+  // Убитый и тут же переиспользованный слот - рождение, а не перемещение
+  world.kill(2);
+  world.spawn(KnightType, 1, 2, "E");
+  frames.publish(world, 3);
+  out.clear();
+  renderer.render(*frames.acquire(), world, out);
+  EXPECT_EQ(out, "+ E at (1, 2)\nChanged: 1\n");
+}
+
+namespace {
+
+std::uint64_t run_simulation(std::uint64_t seed, size_t threads) {
+  SimulationConfig config;
+  config.seed = seed;
+  config.npc_count = 3000;
+  config.max_x = 500;
+  config.max_y = 500;
+
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+  ThreadPool pool(threads);
+  Simulation simulation(world, npcs, config, &pool);
+  for (int tick = 0; tick < 20; ++tick)
+    simulation.step();
+  return world_hash(world);
+}
+
+} // namespace
+
+TEST(SimulationTest, SameSeedSameOutcomeAcrossThreadCounts) {
+  std::uint64_t reference = run_simulation(2024, 1);
+  EXPECT_EQ(run_simulation(2024, 1), reference);
+  EXPECT_EQ(run_simulation(2024, 4), reference);
+  EXPECT_NE(run_simulation(2025, 1), reference);
+}
+
+TEST(SimulationTest, BattleKillsSomebody) {
+  SimulationConfig config;
+  config.seed = 1;
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+  Simulation simulation(world, npcs, config);
+
+  size_t kills = 0;
+  for (int tick = 0; tick < 50; ++tick)
+    kills += simulation.step();
+  EXPECT_GT(kills, 0u);
+  EXPECT_EQ(world.alive_count(), config.npc_count - kills);
+}
+
+// (i, j) и (j, i) сливаются в одну пару, reach помнит оба направления
+TEST(CombatBatchTest, MergesBothDirections) {
+  CombatBatch combat;
+  combat.build({{0, 1}, {0, 2}, {1, 0}, {2, 3}, {3, 1}});
+  const auto &pairs = combat.get_pairs();
+  ASSERT_EQ(pairs.size(), 4u);
+  auto expect = [&](std::size_t k, entity_id a, entity_id b, std::uint8_t reach) {
+    EXPECT_EQ(pairs[k].a, a);
+    EXPECT_EQ(pairs[k].b, b);
+    EXPECT_EQ(pairs[k].reach, reach) << a << "-" << b;
+  };
+  expect(0, 0, 1, FightPair::kReachAB | FightPair::kReachBA);
+  expect(1, 0, 2, FightPair::kReachAB);
+  expect(2, 1, 3, FightPair::kReachBA);
+  expect(3, 2, 3, FightPair::kReachAB);
+  // 0 в двух парах, 1 и 3 тоже
+  EXPECT_EQ(combat.round_count(), 2u);
+}
+
+// В раунде NPC встречается не больше раза, раундов меньше 2 * наибольшей степени
+TEST(CombatBatchTest, RoundsNeverRepeatAnNpc) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 2000, 150, 150, 5);
+  MovementSystem movement(world, 150, 150, 5);
+  CombatBatch combat;
+  combat.build(movement.tick());
+  const auto &pairs = combat.get_pairs();
+  ASSERT_GT(pairs.size(), 1000u);
+
+  std::vector<std::vector<bool>> seen(combat.round_count(), std::vector<bool>(world.size(), false));
+  std::vector<std::size_t> degree(world.size(), 0);
+  for (std::size_t p = 0; p < pairs.size(); ++p) {
+    std::uint32_t round = combat.get_round(p);
+    ASSERT_LT(round, combat.round_count());
+    for (entity_id id : {pairs[p].a, pairs[p].b}) {
+      EXPECT_FALSE(seen[round][id]) << "NPC " << id << " twice in round " << round;
+      seen[round][id] = true;
+      ++degree[id];
+    }
+  }
+  EXPECT_LT(combat.round_count(), 2 * *std::max_element(degree.begin(), degree.end()));
+}
+
+// Раунды NPC с сотнями пар идут за пределы первого слова битовой строки,
+// и соседи по цепочке встают в них без повторов
+TEST(CombatBatchTest, HubSpansSeveralWordsOfRounds) {
+  constexpr entity_id kLeaves = 300;
+  std::vector<FightCandidate> candidates;
+  for (entity_id leaf = 1; leaf <= kLeaves; ++leaf)
+    candidates.push_back({0, leaf});
+  for (entity_id leaf = 1; leaf < kLeaves; ++leaf)
+    candidates.push_back({leaf + 1, leaf});
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto &l, const auto &r) { return std::pair(l.attacker, l.defender) < std::pair(r.attacker, r.defender); });
+  CombatBatch combat;
+  combat.build(candidates);
+  const auto &pairs = combat.get_pairs();
+  ASSERT_EQ(pairs.size(), 2 * std::size_t(kLeaves) - 1);
+
+  std::vector<std::set<entity_id>> seen(combat.round_count());
+  for (std::size_t p = 0; p < pairs.size(); ++p) {
+    std::uint32_t round = combat.get_round(p);
+    ASSERT_LT(round, combat.round_count());
+    if (pairs[p].a == 0)
+      EXPECT_EQ(round, pairs[p].b - 1);
+    for (entity_id id : {pairs[p].a, pairs[p].b})
+      EXPECT_TRUE(seen[round].insert(id).second) << "NPC " << id << " twice in round " << round;
+  }
+  EXPECT_LT(combat.round_count(), 2 * std::size_t(kLeaves));
+}
+
+// Раунды, посчитанные пулом, дают тот же мир и те же события в том же
+// порядке, что и последовательный проход
+TEST(CombatBatchTest, ParallelMatchesSerial) {
+  auto run = [](ThreadPool *pool, std::vector<entity_id> &killed, std::vector<FightOutcome> &events) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    auto observer = std::make_shared<BatchObserver>();
+    world.events.subscribe(observer);
+    populate(world, npcs, 20000, 300, 300, 8);
+    MovementSystem movement(world, 300, 300, 8);
+    CombatBatch combat;
+    combat.build(movement.tick());
+    std::size_t first_round = 0;
+    for (std::size_t p = 0; p < combat.get_pairs().size(); ++p)
+      first_round += combat.get_round(p) == 0;
+    EXPECT_GE(first_round, CombatBatch::kParallelRound);
+    combat.resolve(world, npcs, 8, 0, pool, nullptr, &killed);
+    world.events.dispatch();
+    events = observer->events;
+    return world_hash(world);
+  };
+  std::vector<entity_id> serial_killed;
+  std::vector<FightOutcome> serial_events;
+  std::uint64_t serial = run(nullptr, serial_killed, serial_events);
+  ThreadPool pool(4);
+  std::vector<entity_id> parallel_killed;
+  std::vector<FightOutcome> parallel_events;
+  EXPECT_EQ(run(&pool, parallel_killed, parallel_events), serial);
+  EXPECT_EQ(parallel_killed, serial_killed);
+  EXPECT_FALSE(serial_killed.empty());
+  ASSERT_EQ(parallel_events.size(), serial_events.size());
+  for (std::size_t k = 0; k < serial_events.size(); ++k) {
+    EXPECT_EQ(parallel_events[k].attacker, serial_events[k].attacker);
+    EXPECT_EQ(parallel_events[k].defender, serial_events[k].defender);
+    EXPECT_EQ(parallel_events[k].kind, serial_events[k].kind);
+  }
+}
+
+// Погибший в раннем раунде не участвует в своих следующих парах
+TEST(CombatBatchTest, DeadNpcSkipsLaterPairs) {
+  bool cut_short = false;
+  for (std::uint64_t tick = 0; tick < 20; ++tick) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    npcs.push_back(create_npc(world, DragonType, 5, 5, "D"));
+    std::vector<FightCandidate> candidates;
+    for (entity_id k = 1; k <= 8; ++k) {
+      npcs.push_back(create_npc(world, KnightType, 5, 5, "K" + std::to_string(k)));
+      candidates.push_back({0, k});
+    }
+    for (entity_id k = 1; k <= 8; ++k)
+      candidates.push_back({k, 0});
+
+    CombatBatch combat;
+    combat.build(candidates);
+    ASSERT_EQ(combat.get_pairs().size(), 8u);
+    ASSERT_EQ(combat.round_count(), 8u);
+    Metrics metrics;
+    std::vector<entity_id> killed;
+    std::size_t kills = combat.resolve(world, npcs, 3, tick, nullptr, &metrics, &killed);
+    std::uint64_t resolved = metrics.snapshot().counter(Counter::FightsResolved);
+    ASSERT_LE(kills, 1u);
+    if (kills == 1) {
+      EXPECT_EQ(killed, std::vector<entity_id>{0});
+      cut_short = cut_short || resolved < 8;
+    } else {
+      EXPECT_EQ(resolved, 8u);
+    }
+  }
+  EXPECT_TRUE(cut_short);
+}
+
+namespace {
+
+Behavior sleeper(Agent self, std::uint64_t period, std::vector<std::uint64_t> &resumed_at) {
+  for (;;) {
+    resumed_at.push_back(self.tick());
+    co_await self.sleep(period);
+  }
+}
+
+Behavior lurker(Agent self, int radius, std::vector<entity_id> &seen) {
+  for (;;)
+    seen.push_back(co_await self.sense(SensePrey, radius));
+}
+
+} // namespace
+
+// Спящее поведение возобновляется только на своих тиках, в том числе дальше колеса
+TEST(BehaviorTest, SleepResumesOnlyWhenDue) {
+  World world;
+  entity_id fast = world.spawn(KnightType, 0, 0, "K");
+  entity_id slow = world.spawn(KnightType, 0, 0, "K2");
+  BehaviorScheduler scheduler(world, 100, 100, 1);
+  std::vector<std::uint64_t> fast_log, slow_log;
+  scheduler.attach(fast, sleeper(Agent(scheduler, fast), 3, fast_log));
+  scheduler.attach(slow, sleeper(Agent(scheduler, slow), 300, slow_log));
+  EXPECT_EQ(world.scripted[fast], 1);
+
+  std::size_t resumes = 0;
+  for (std::uint64_t tick = 0; tick <= 610; ++tick)
+    resumes += scheduler.run(tick);
+  EXPECT_EQ(slow_log, (std::vector<std::uint64_t>{0, 300, 600}));
+  ASSERT_EQ(fast_log.size(), 204u);
+  EXPECT_EQ(fast_log[1], 3u);
+  EXPECT_EQ(fast_log.back(), 609u);
+  EXPECT_EQ(resumes, fast_log.size() + slow_log.size());
+}
+
+// Ждущий датчика просыпается, только когда добыча входит в радиус
+TEST(BehaviorTest, SenseWakesOnPrey) {
+  World world;
+  entity_id dragon = world.spawn(DragonType, 0, 0, "D");
+  world.spawn(KnightType, 10, 0, "K"); // не добыча
+  entity_id pegasus = world.spawn(PegasusType, 200, 0, "P");
+  BehaviorScheduler scheduler(world, 1000, 1000, 1);
+  std::vector<entity_id> seen;
+  scheduler.attach(dragon, lurker(Agent(scheduler, dragon), 50, seen));
+
+  scheduler.run(0);
+  EXPECT_EQ(scheduler.watching(), 1u);
+  for (std::uint64_t tick = 1; tick <= 5; ++tick) {
+    world.x[pegasus] -= 30;
+    EXPECT_EQ(scheduler.run(tick), world.x[pegasus] <= 50 ? 1u : 0u) << "tick " << tick;
+  }
+  EXPECT_EQ(seen, (std::vector<entity_id>{pegasus}));
+}
+
+// Поведение погибшего NPC уничтожается, кадр возвращается в пул
+TEST(BehaviorTest, DeadNpcBehaviorIsDestroyed) {
+  World world;
+  entity_id knight = world.spawn(KnightType, 0, 0, "K");
+  entity_id dragon = world.spawn(DragonType, 5, 5, "D");
+  std::size_t frames_before = behavior_frame_bytes();
+  {
+    BehaviorScheduler scheduler(world, 100, 100, 1);
+    std::vector<std::uint64_t> log;
+    std::vector<entity_id> seen;
+    scheduler.attach(knight, sleeper(Agent(scheduler, knight), 1, log));
+    scheduler.attach(dragon, lurker(Agent(scheduler, dragon), 1, seen));
+    EXPECT_GT(behavior_frame_bytes(), frames_before);
+    scheduler.run(0);
+
+    world.kill(knight);
+    world.kill(dragon);
+    EXPECT_EQ(scheduler.run(1), 0u);
+    EXPECT_EQ(scheduler.attached(), 0u);
+    EXPECT_EQ(scheduler.watching(), 0u);
+    EXPECT_EQ(behavior_frame_bytes(), frames_before);
+
+    // Занятый заново слот получает случайный шаг, а не старое поведение
+    EXPECT_EQ(world.spawn(PegasusType, 1, 1, "P"), dragon);
+    EXPECT_EQ(world.scripted[dragon], 0);
+  }
+  EXPECT_EQ(behavior_frame_bytes(), frames_before);
+}
+
+// Поведения по умолчанию не ломают воспроизводимость по числу потоков
+TEST(BehaviorTest, DefaultBehaviorsAreDeterministic) {
+  auto run = [](std::size_t threads) {
+    SimulationConfig config;
+    config.seed = 17;
+    config.npc_count = 3000;
+    config.max_x = 600;
+    config.max_y = 600;
+    config.behaviors = true;
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+    ThreadPool pool(threads);
+    Simulation simulation(world, npcs, config, &pool);
+    EXPECT_EQ(simulation.get_behaviors()->attached(), config.npc_count);
+    std::size_t kills = 0;
+    for (int tick = 0; tick < 30; ++tick)
+      kills += simulation.step();
+    EXPECT_GT(kills, 0u);
+    return world_hash(world);
+  };
+  EXPECT_EQ(run(1), run(4));
+}
+
+namespace {
+
+std::int64_t squared_distance(const World &world, entity_id id, int x, int y) {
+  std::int64_t dx = std::int64_t(world.x[id]) - x;
+  std::int64_t dy = std::int64_t(world.y[id]) - y;
+  return dx * dx + dy * dy;
+}
+
+// Все три вида запросов против полного перебора живых NPC
+void expect_index_matches_brute_force(const SpatialIndex &index, const World &world, std::uint64_t seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<> coord(-50, 1050);
+  std::uniform_int_distribution<> mask_dist(1, 15);
+  std::vector<entity_id> got, want;
+  for (int q = 0; q < 200; ++q) {
+    int x = coord(gen), y = coord(gen);
+    TypeMask types = q % 3 ? TypeMask(mask_dist(gen) << 0) : kAnyType;
+    auto match = [&](entity_id id) { return world.alive[id] && (type_bit(world.type[id]) & types); };
+
+    int radius = q % 40 * 5;
+    got.clear();
+    want.clear();
+    index.within_radius({x, y, radius, types}, got);
+    for (entity_id id = 0; id < world.size(); ++id) {
+      if (match(id) && squared_distance(world, id, x, y) <= std::int64_t(radius) * radius)
+        want.push_back(id);
+    }
+    std::sort(got.begin(), got.end());
+    EXPECT_EQ(got, want) << "radius query " << q;
+
+    BoxQuery box{x - q, y - 2 * q, x + 3 * q, y + q, types};
+    got.clear();
+    want.clear();
+    index.in_box(box, got);
+    for (entity_id id = 0; id < world.size(); ++id) {
+      if (match(id) && world.x[id] >= box.min_x && world.x[id] <= box.max_x && world.y[id] >= box.min_y &&
+          world.y[id] <= box.max_y)
+        want.push_back(id);
+    }
+    std::sort(got.begin(), got.end());
+    EXPECT_EQ(got, want) << "box query " << q;
+
+    std::size_t k = q % 20;
+    got.clear();
+    want.clear();
+    index.nearest({x, y, k, types}, got);
+    for (entity_id id = 0; id < world.size(); ++id) {
+      if (match(id))
+        want.push_back(id);
+    }
+    std::sort(want.begin(), want.end(), [&](entity_id a, entity_id b) {
+      std::int64_t da = squared_distance(world, a, x, y), db = squared_distance(world, b, x, y);
+      return da != db ? da < db : a < b;
+    });
+    want.resize(std::min(k, want.size()));
+    EXPECT_EQ(got, want) << "nearest query " << q;
+  }
+}
+
+} // namespace
+
+TEST(SpatialIndexTest, MatchesBruteForceAfterBuildAndRefit) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 5000, 1000, 1000, 31);
+  for (entity_id id = 0; id < world.size(); id += 7)
+    world.kill(id);
+
+  SpatialIndex index;
+  index.build(world);
+  EXPECT_EQ(index.size(), world.alive_count());
+  expect_index_matches_brute_force(index, world, 1);
+
+  // Движение и смерти без рождений - refit; рождение требует build
+  MovementSystem movement(world, 1000, 1000, 31);
+  for (int tick = 0; tick < 3; ++tick)
+    movement.tick();
+  for (entity_id id = 1; id < world.size(); id += 11)
+    world.kill(id);
+  EXPECT_TRUE(index.refit(world));
+  EXPECT_EQ(index.size(), world.alive_count());
+  expect_index_matches_brute_force(index, world, 2);
+
+  // Рождение в освобождённом слоте refit подхватывает, в новом - нет
+  world.spawn(DragonType, 500, 500, "Reused");
+  EXPECT_TRUE(index.refit(world));
+  expect_index_matches_brute_force(index, world, 3);
+  while (world.free_count() > 0)
+    world.spawn(KnightType, 10, 10, "Filler");
+  world.spawn(DragonType, 501, 501, "New");
+  EXPECT_FALSE(index.refit(world));
+  index.build(world);
+  expect_index_matches_brute_force(index, world, 3);
+}
+
+TEST(SpatialIndexTest, BatchesMatchSingleQueries) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 20000, 2000, 2000, 4);
+  SpatialIndex index;
+  index.build(world);
+
+  std::vector<RadiusQuery> radius;
+  std::vector<BoxQuery> boxes;
+  std::vector<NearestQuery> nearest;
+  for (int q = 0; q < 1000; ++q) {
+    int x = q * 37 % 2000, y = q * 91 % 2000;
+    radius.push_back({x, y, 40, q % 2 ? kAnyType : type_bit(DragonType)});
+    boxes.push_back({x, y, x + 60, y + 30});
+    nearest.push_back({x, y, std::size_t(q % 9)});
+  }
+
+  ThreadPool pool(4);
+  QueryResults serial, parallel;
+  std::vector<entity_id> single;
+  auto check = [&](const auto &queries, auto &&one) {
+    index.query(queries, serial);
+    index.query(queries, parallel, &pool);
+    ASSERT_EQ(serial.size(), queries.size());
+    EXPECT_EQ(parallel.ids, serial.ids);
+    EXPECT_EQ(parallel.offsets, serial.offsets);
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+      single.clear();
+      one(queries[q], single);
+      EXPECT_EQ(std::vector<entity_id>(serial.begin(q), serial.end(q)), single);
+    }
+  };
+  check(radius, [&](const RadiusQuery &query, std::vector<entity_id> &out) { index.within_radius(query, out); });
+  check(boxes, [&](const BoxQuery &query, std::vector<entity_id> &out) { index.in_box(query, out); });
+  check(nearest, [&](const NearestQuery &query, std::vector<entity_id> &out) { index.nearest(query, out); });
+  EXPECT_GT(serial.ids.size(), 0u);
+}
+
+// Индекс симуляции следует за тиками: refit между перестройками
+TEST(SpatialIndexTest, SimulationIndexFollowsTicks) {
+  SimulationConfig config;
+  config.seed = 12;
+  config.npc_count = 3000;
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+  Simulation simulation(world, npcs, config);
+  for (int tick = 0; tick < 12; ++tick) {
+    simulation.step();
+    const SpatialIndex &index = simulation.spatial();
+    EXPECT_EQ(index.size(), world.alive_count());
+    if (tick % 5 == 0)
+      expect_index_matches_brute_force(index, world, tick);
+  }
+}
+
+// Шарды в отдельных процессах дают тот же мир, что и один процесс
+TEST(ShardTest, MatchesSingleProcess) {
+  SimulationConfig config;
+  config.seed = 21;
+  config.npc_count = 3000;
+  config.max_x = 600;
+  config.max_y = 300;
+
+  World single_world;
+  std::vector<std::shared_ptr<NPC>> single_npcs;
+  populate(single_world, single_npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+  Simulation simulation(single_world, single_npcs, config);
+  std::vector<std::size_t> single_kills;
+  for (int tick = 0; tick < 15; ++tick)
+    single_kills.push_back(simulation.step());
+
+  for (std::size_t shards : {1, 3, 4}) {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+    ShardCoordinator coordinator(world, npcs, config, shards);
+    ASSERT_EQ(coordinator.shard_count(), shards);
+    for (int tick = 0; tick < 15; ++tick)
+      EXPECT_EQ(coordinator.step(), single_kills[tick]) << shards << " shards, tick " << tick;
+    coordinator.collect();
+
+    EXPECT_EQ(world_hash(world), world_hash(single_world)) << shards << " shards";
+    EXPECT_EQ(world.alive_count(), single_world.alive_count());
+    if (shards > 1) {
+      EXPECT_GT(coordinator.stats().migrated, 0u);
+      EXPECT_GT(coordinator.stats().guests, 0u);
+    }
+  }
+}
+
+// Полоса не уже дистанции убийства: лишние шарды отбрасываются
+TEST(ShardTest, StripsAreNotNarrowerThanHalo) {
+  SimulationConfig config;
+  config.max_x = 99;
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  populate(world, npcs, 20, config.max_x, config.max_y, 1);
+  ShardCoordinator coordinator(world, npcs, config, 16);
+  EXPECT_EQ(coordinator.shard_count(), 3u); // 100 / 30
+  coordinator.step();
+}
+
+TEST(AsyncLoggerTest, FormatsRecordsFromAllThreads) {
+  World world;
+  world.spawn(KnightType, 0, 0, "K");
+  world.spawn(DragonType, 0, 0, "D");
+
+  std::ostringstream out;
+  AsyncLogger logger(world, {});
+  logger.add_sink(out);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100; ++i)
+        logger.log(LogEvent::Kill, i, 0, 1);
+    });
+  for (auto &t : threads)
+    t.join();
+  logger.flush();
+
+  EXPECT_EQ(logger.written(), 400u);
+  std::string text = out.str();
+  EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), 400);
+  EXPECT_EQ(text.substr(0, 22), "Murder: K killed D\nMur");
+}
+
+TEST(AsyncLoggerTest, DropPolicyCountsOverflow) {
+  World world;
+  world.spawn(KnightType, 0, 0, "K");
+
+  AsyncLogger::Options options;
+  options.ring_capacity = 8;
+  options.flush_interval = std::chrono::milliseconds(1000);
+  AsyncLogger logger(world, options);
+  std::ostringstream out;
+  logger.add_sink(out);
+
+  for (int i = 0; i < 20; ++i)
+    logger.log(LogEvent::Fight, 0, 0, 0);
+  logger.flush();
+  EXPECT_EQ(logger.written() + logger.dropped(), 20u);
+  EXPECT_GE(logger.dropped(), 12u);
+}
+
+TEST(AsyncLoggerTest, AlternatingLoggersKeepOneRingEach) {
+  World world;
+  world.spawn(KnightType, 0, 0, "K");
+
+  AsyncLogger::Options options;
+  options.ring_capacity = 8;
+  options.flush_interval = std::chrono::milliseconds(1000);
+  AsyncLogger first(world, options), second(world, options);
+
+  // Новое кольцо на каждое переключение не переполнилось бы никогда
+  for (int i = 0; i < 20; ++i) {
+    first.log(LogEvent::Fight, 0, 0, 0);
+    second.log(LogEvent::Fight, 0, 0, 0);
+  }
+  first.flush();
+  second.flush();
+  EXPECT_GE(first.dropped(), 12u);
+  EXPECT_GE(second.dropped(), 12u);
+}
+
+TEST(AsyncLoggerTest, BlockPolicyLosesNothing) {
+  World world;
+  world.spawn(KnightType, 0, 0, "K");
+
+  AsyncLogger::Options options;
+  options.ring_capacity = 8;
+  options.overflow = OverflowPolicy::Block;
+  options.flush_interval = std::chrono::milliseconds(1);
+  AsyncLogger logger(world, options);
+  std::ostringstream out;
+  logger.add_sink(out);
+
+  for (int i = 0; i < 200; ++i)
+    logger.log(LogEvent::Fight, 0, 0, 0);
+  logger.flush();
+  EXPECT_EQ(logger.written(), 200u);
+  EXPECT_EQ(logger.dropped(), 0u);
+}
+
+TEST(AsyncLoggerTest, ObserverLogsOnlyKills) {
+  World world;
+  auto knight = std::make_shared<Knight>(world, world.spawn(KnightType, 0, 0, "K"));
+  auto dragon = std::make_shared<Dragon>(world, world.spawn(DragonType, 0, 0, "D"));
+
+  std::ostringstream out;
+  AsyncLogger logger(world, {});
+  logger.add_sink(out);
+  world.events.subscribe(std::make_shared<LogObserver>(logger), EventFilter::only(FightKind::Kill));
+
+  dragon->accept(knight);
+  knight->accept(dragon);
+  world.events.dispatch();
+  logger.flush();
+  EXPECT_EQ(out.str(), "Murder: K killed D\n");
+}
+
+TEST(MetricsTest, AggregatesPerThreadBlocks) {
+  Metrics metrics;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 1000; ++i)
+        metrics.add(Counter::PairsTested);
+      metrics.record(Timer::Fight, std::chrono::microseconds(t + 1));
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  MetricsSnapshot s = metrics.snapshot();
+  EXPECT_EQ(s.counter(Counter::PairsTested), 4000u);
+  EXPECT_EQ(s.counter(Counter::Kills), 0u);
+  EXPECT_EQ(s.timer(Timer::Fight).count, 4u);
+  EXPECT_EQ(s.timer(Timer::Fight).total_ns, 10000u);
+  EXPECT_EQ(s.timer(Timer::Fight).max_ns, 4000u);
+}
+
+TEST(MetricsTest, AlternatingInstancesKeepOneBlockEach) {
+  Metrics first, second;
+  for (int i = 0; i < 100; ++i) {
+    first.add(Counter::Kills);
+    second.add(Counter::PairsTested, 2);
+  }
+  EXPECT_EQ(first.block_count(), 1u);
+  EXPECT_EQ(second.block_count(), 1u);
+  EXPECT_EQ(first.snapshot().counter(Counter::Kills), 100u);
+  EXPECT_EQ(second.snapshot().counter(Counter::PairsTested), 200u);
+}
+
+TEST(MetricsTest, QuantilesFollowBuckets) {
+  Metrics metrics;
+  for (int i = 0; i < 99; ++i)
+    metrics.record(Timer::Move, std::chrono::nanoseconds(100));
+  metrics.record(Timer::Move, std::chrono::nanoseconds(5000));
+
+  MetricsSnapshot s = metrics.snapshot();
+  const TimerStats &move = s.timer(Timer::Move);
+  EXPECT_EQ(move.quantile_ns(0.5), 127u);
+  EXPECT_EQ(move.quantile_ns(0.99), 127u);
+  EXPECT_EQ(move.quantile_ns(1.0), 5000u);
+}
+
+TEST(MetricsTest, SimulationFillsPhasesAndJsonLine) {
+  World world;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  SimulationConfig config;
+  config.seed = 9;
+  config.npc_count = 200;
+  populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+
+  Metrics metrics;
+  Simulation simulation(world, npcs, config);
+  simulation.set_metrics(&metrics);
+  std::size_t kills = 0;
+  for (int tick = 0; tick < 20; ++tick)
+    kills += simulation.step();
+
+  MetricsSnapshot s = metrics.snapshot();
+  EXPECT_EQ(s.timer(Timer::Move).count, 20u);
+  EXPECT_EQ(s.timer(Timer::Detect).count, 20u);
+  EXPECT_EQ(s.timer(Timer::Notify).count, 20u);
+  EXPECT_GT(s.counter(Counter::PairsTested), 0u);
+  EXPECT_EQ(s.counter(Counter::Kills), kills);
+
+  std::ostringstream os;
+  write_metrics_json(os, s, simulation.get_tick());
+  std::string line = os.str();
+  EXPECT_EQ(line.rfind("{\"tick\":20,\"counters\":{\"pairs_tested\":", 0), 0u);
+  EXPECT_NE(line.find("\"checkpoint\":{\"count\":0"), std::string::npos);
+  EXPECT_EQ(line.find("queue"), std::string::npos);
+  EXPECT_EQ(std::count(line.begin(), line.end(), '\n'), 1);
+}
+
+std::string fresh_dir(const std::string &name) {
+  std::string dir = testing::TempDir() + name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+std::string newest_journal(const std::string &dir) {
+  std::string newest;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    std::string path = entry.path().string();
+    if (entry.path().filename().string().rfind("journal-", 0) == 0 && path > newest)
+      newest = path;
+  }
+  return newest;
+}
+
+TEST(JournalTest, CollectsOnlyChanges) {
+  World world;
+  for (int i = 0; i < 1000; ++i)
+    world.spawn(KnightType, i, 0, "K");
+  world.track_changes(true);
+
+  WorldChanges changes;
+  world.collect_changes(changes);
+  EXPECT_EQ(changes.size(), 0u);
+  std::string block;
+  encode_journal_block(world, changes, 1, block);
+  EXPECT_EQ(block.size(), sizeof(JournalBlockHeader) + 3);
+
+  world.move(7, 1, 0, 5000, 5000);
+  world.move(500, 0, 0, 5000, 5000); // на месте - не изменение
+  world.move(900, 0, 3, 5000, 5000);
+  world.move(3, 1, 1, 5000, 5000);
+  world.kill(3);
+  world.kill(10);
+  world.spawn(DragonType, 1, 1, "Reborn"); // в слот 10
+  world.spawn_bulk({{DragonType, 2, 2, "New"}}); // новый слот 1000
+  world.collect_changes(changes);
+  EXPECT_EQ(changes.moved, (std::vector<entity_id>{7, 900}));
+  EXPECT_EQ(changes.died, (std::vector<entity_id>{3}));
+  EXPECT_EQ(changes.born, (std::vector<entity_id>{10, 1000}));
+
+  world.collect_changes(changes);
+  EXPECT_EQ(changes.size(), 0u);
+}
+
+// Прогон с контрольными точками, падение с оборванным хвостом журнала,
+// восстановление и продолжение дают тот же мир, что и прогон без падения
+TEST(JournalTest, RecoversAfterTornTail) {
+  SimulationConfig config;
+  config.seed = 17;
+  config.npc_count = 3000;
+  config.max_x = config.max_y = 500;
+
+  std::vector<std::uint64_t> hashes;
+  {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+    Simulation simulation(world, npcs, config);
+    for (int tick = 0; tick < 23; ++tick) {
+      simulation.step();
+      hashes.push_back(world_hash(world));
+    }
+  }
+
+  config.checkpoint_dir = fresh_dir("journal_torn");
+  config.checkpoint_every = 5;
+  {
+    World world;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    populate(world, npcs, config.npc_count, config.max_x, config.max_y, config.seed);
+    Simulation simulation(world, npcs, config);
+    for (int tick = 0; tick < 23; ++tick)
+      simulation.step();
+    simulation.get_checkpoints()->wait();
+    EXPECT_EQ(simulation.get_checkpoints()->stats().snapshot_tick, 20u);
+    EXPECT_EQ(simulation.get_checkpoints()->stats().blocks, 23u);
+  }
+
+  World recovered;
+  EXPECT_EQ(recover(recovered, config.checkpoint_dir), 23u);
+  EXPECT_EQ(world_hash(recovered), hashes[22]);
+
+  // Последний блок дописан наполовину
+  std::string journal = newest_journal(config.checkpoint_dir);
+  std::filesystem::resize_file(journal, std::filesystem::file_size(journal) - 10);
+  World torn;
+  std::vector<std::shared_ptr<NPC>> npcs;
+  config.start_tick = recover(torn, config.checkpoint_dir);
+  ASSERT_EQ(config.start_tick, 22u);
+  EXPECT_EQ(world_hash(torn), hashes[21]);
+
+  for (entity_id id = 0; id < torn.size(); ++id)
+    npcs.push_back(make_handle(torn, id));
+  Simulation resumed(torn, npcs, config);
+  resumed.step();
+  EXPECT_EQ(world_hash(torn), hashes[22]);
+  std::filesystem::remove_all(config.checkpoint_dir);
+}
+
+// Слот занят и освобождён заново за один тик: журнал несёт имя нового
+// NPC вместе со смертью, восстановленный мир совпадает по именам
+TEST(JournalTest, RebornAndKilledInOneTickKeepsName) {
+  std::string dir = fresh_dir("journal_reborn");
+  World world;
+  for (int i = 0; i < 10; ++i)
+    world.spawn(KnightType, i, i, "K" + std::to_string(i));
+  {
+    Checkpointer checkpoints(world, dir, 1000);
+    world.kill(3);
+    EXPECT_EQ(world.spawn(DragonType, 7, 7, "Ghost"), 3u);
+    world.kill(3);
+    entity_id fresh = world.spawn_bulk({{PegasusType, 8, 8, "Passerby"}});
+    world.kill(fresh);
+    checkpoints.commit(1);
+  }
+
+  World recovered;
+  EXPECT_EQ(recover(recovered, dir), 1u);
+  ASSERT_EQ(recovered.size(), world.size());
+  for (entity_id id = 0; id < world.size(); ++id) {
+    EXPECT_EQ(recovered.name(id), world.name(id));
+    EXPECT_EQ(recovered.type[id], world.type[id]);
+    EXPECT_EQ(recovered.alive[id], world.alive[id]);
+  }
+  EXPECT_EQ(world_hash(recovered), world_hash(world));
+  std::filesystem::remove_all(dir);
+}
+
+// Испорченный байт в середине журнала: повтор останавливается перед ним
+TEST(JournalTest, StopsAtCorruptBlock) {
+  std::string dir = fresh_dir("journal_corrupt");
+  World world;
+  for (int i = 0; i < 100; ++i)
+    world.spawn(PegasusType, i, i, "P" + std::to_string(i));
+
+  std::vector<std::uint64_t> hashes;
+  {
+    Checkpointer checkpoints(world, dir, 1000);
+    for (std::uint64_t tick = 1; tick <= 10; ++tick) {
+      for (entity_id id = 0; id < world.size(); id += 3)
+        world.move(id, 1, 2, 1000, 1000);
+      world.kill(entity_id(tick * 7));
+      world.spawn(DragonType, int(tick), 0, "An unusually long dragon name number " + std::to_string(tick));
+      world.spawn_bulk({{KnightType, 5, 5, "Bulk"}});
+      checkpoints.commit(tick);
+      hashes.push_back(world_hash(world));
+    }
+  }
+
+  World full;
+  EXPECT_EQ(recover(full, dir), 10u);
+  EXPECT_EQ(world_hash(full), hashes[9]);
+  EXPECT_EQ(full.alive_count(), world.alive_count());
+  for (entity_id id = 0; id < world.size(); ++id)
+    ASSERT_EQ(full.name(id), world.name(id)) << id;
+
+  // Байт в теле шестого блока: целы только первые пять
+  std::string journal = newest_journal(dir);
+  std::size_t offset = 0;
+  {
+    std::ifstream is(journal, std::ios::binary);
+    for (int block = 0; block < 5; ++block) {
+      JournalBlockHeader header;
+      is.seekg(std::streamoff(offset));
+      is.read(reinterpret_cast<char *>(&header), sizeof(header));
+      offset += sizeof(header) + header.size;
+    }
+  }
+  {
+    std::fstream io(journal, std::ios::binary | std::ios::in | std::ios::out);
+    std::streamoff at = std::streamoff(offset + sizeof(JournalBlockHeader) + 2);
+    io.seekg(at);
+    char byte = char(io.get());
+    io.seekp(at);
+    io.put(char(byte ^ 0x55));
+  }
+  World partial;
+  EXPECT_EQ(recover(partial, dir), 5u);
+  EXPECT_EQ(world_hash(partial), hashes[4]);
+  std::filesystem::remove_all(dir);
+}
+
+#if DUNGEON_TRACE
+TEST(TraceTest, PerThreadBuffersKeepRoomForSpans) {
+  Tracer &tracer = Tracer::global();
+  tracer.start(16);
+  std::thread worker([] {
+    TRACE_THREAD_NAME("test worker");
+    TRACE_SCOPE("work");
+    for (int i = 0; i < 100; ++i)
+      TRACE_INSTANT("fight", 1, 2);
+  });
+  worker.join();
+  {
+    TRACE_SCOPE("main span");
+  }
+  tracer.stop();
+  TRACE_INSTANT("kill", 3, 4);
+
+  // Мгновенные события занимают не больше трёх четвертей буфера
+  EXPECT_EQ(tracer.recorded(), 15u);
+  EXPECT_EQ(tracer.dropped(), 89u);
+
+  std::ostringstream os;
+  tracer.write_chrome_json(os);
+  std::string json = os.str();
+  EXPECT_NE(json.find("\"args\":{\"name\":\"test worker\"}"), std::string::npos);
+  EXPECT_NE(json.find("{\"name\":\"work\",\"ph\":\"E\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"attacker\":1,\"defender\":2}"), std::string::npos);
+  EXPECT_NE(json.find("{\"name\":\"main span\",\"ph\":\"B\""), std::string::npos);
+  EXPECT_EQ(json.find("kill"), std::string::npos);
+}
+#endif
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();